@@ -1,4 +1,7 @@
 #include "Monitor.h"
+#include "server_table.h"
+#include "simulator.h"
+#include "timer_wheel.h"
 
 #include <fstream>
 
@@ -10,10 +13,11 @@ Monitor::Monitor()
 
 void Monitor::Stop()
 {
-    shutdown_ = true;
+    timer_.Cancel();
 
-    if (monitor_thread_.joinable())
-        monitor_thread_.join();
+    // 取消时可能正好有一次采样在时间轮线程中执行，等它结束后再返回
+    std::lock_guard<std::mutex> guard(mutex_);
+    shutdown_ = true;
 }
 
 Monitor & Monitor::Instance()
@@ -26,7 +30,26 @@ void Monitor::Init(const std::vector<std::shared_ptr<Server>> &server_pool)
 {
     servers_ = server_pool;
 
-    monitor_thread_ = std::thread([this] { ThreadFunc(); });
+    last_wait_histograms_.resize(servers_.size());
+    last_total_histograms_.resize(servers_.size());
+
+    if (g_config.Simulate)
+    {
+        Simulator::Instance().Every(std::chrono::seconds(1), [this]() {
+            if (shutdown_)
+                return false;
+            SampleOnce_();
+            return true;
+        });
+        return;
+    }
+
+    // 采样注册在全局时间轮上，不再单独占用一个线程
+    timer_ = TimerWheel::Instance().Every(std::chrono::seconds(1), [this]() {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (!shutdown_)
+            SampleOnce_();
+    });
 }
 
 template<typename T>
@@ -43,104 +66,102 @@ static T max(std::vector<T> v)
     return result;
 }
 
-void Monitor::ThreadFunc()
+void Monitor::SampleOnce_()
 {
-    // 放在 while 外面减少内存分配
     std::vector<double> cpu;
     std::vector<double> ram;
     std::vector<double> wait_time;
     std::vector<double> other;
 
-    int server_count = 0;   // 上面三个 vector 的 size 应该和这个 server_count 严格一致
-
-
-    while (!shutdown_)
-    {
-        double var_cpu = 0;
-        double var_ram = 0;
-        double var_wait_time = 0;
-        double var_other = 0;
-
-        for (const auto& server : servers_)
-        {
-            double cpu_load = server->GetCpuLoad();
-            cpu.push_back(cpu_load);
-            ram.push_back(server->GetRamLoad());
-            wait_time.push_back(0);
-            other.push_back(0);
-
-            //server->PrintStatus();
-
-            server_count++;
-
-            /*
-            * 试验调整QPS以使数据图更好看
-            */
-            if (cpu_load >= 10)
-            {
-                server->ReduceQps();
-            }
-            else if (cpu_load <= 1)
-            {
-                server->RaiseQps();
-            }
-
-        }
-
-        /* 求和 */
-        double sum_cpu = std::accumulate(cpu.begin(), cpu.end(), 0.0);
-        double sum_ram = std::accumulate(ram.begin(), ram.end(), 0.0);
-        double sum_wait_time = std::accumulate(wait_time.begin(), wait_time.end(), 0.0);
-        double sum_other = std::accumulate(other.begin(), other.end(), 0.0);
+    cpu.reserve(servers_.size());
+    ram.reserve(servers_.size());
+    wait_time.reserve(servers_.size());
+    other.reserve(servers_.size());
 
-        /* 求平均值 */
-        double mean_cpu = sum_cpu / server_count;
-        double mean_ram = sum_ram / server_count;
-        double mean_wait_time = sum_wait_time / server_count;
-        double mean_other = sum_other / server_count;
+    int server_count = 0;   // 上面四个 vector 的 size 应该和这个 server_count 严格一致
 
-        avg_experiment_data_.emplace_back(std::vector<double>{mean_cpu, mean_ram, mean_wait_time, mean_other});
+    double var_cpu = 0;
+    double var_ram = 0;
+    double var_wait_time = 0;
+    double var_other = 0;
 
-        /* 求方差 */
-        for (int i = 0; i < server_count; ++i)
-        {
-            var_cpu += std::pow(cpu[i] - mean_cpu, 2);
-            var_ram += std::pow(ram[i] - mean_ram, 2);
-            var_wait_time += std::pow(wait_time[i] - mean_wait_time, 2);
-            var_other += std::pow(other[i] - mean_other, 2);
-        }
+    // 快照表还没有初始化或服务器数量不一致时直接读取服务器
+    EpochDomain::ReadGuard read_guard;
+    const ServerSnapshot* snapshot = ServerTable::Instance().Load();
+    if (snapshot != nullptr && snapshot->Size() != servers_.size())
+        snapshot = nullptr;
 
-        var_cpu /= server_count;
-        var_ram /= server_count;
-        var_wait_time /= server_count;
-        var_other /= server_count;
+    for (const auto& server : servers_)
+    {
+        double cpu_load = snapshot ? snapshot->load[server_count] : server->GetCpuLoad();
+        cpu.push_back(cpu_load);
+        ram.push_back(snapshot ? snapshot->ram_load[server_count] : server->GetRamLoad());
 
-        var_experiment_data_.emplace_back(std::vector<double>{var_cpu, var_ram, var_wait_time, var_other});
+        /* 等待时间取采样周期内的平均值，other 取采样周期内总耗时的 p99，单位都换算为 ms */
+        auto wait_histogram = server->GetQueueWaitHistogram();
+        auto total_histogram = server->GetTotalTimeHistogram();
 
-        /* 求最大值 */
-        max_experiment_data_.emplace_back(std::vector<double>{max(cpu), max(ram), max(wait_time), max(other)});
+        auto wait_delta = wait_histogram;
+        wait_delta.Subtract(last_wait_histograms_[server_count]);
+        last_wait_histograms_[server_count] = wait_histogram;
 
+        auto total_delta = total_histogram;
+        total_delta.Subtract(last_total_histograms_[server_count]);
+        last_total_histograms_[server_count] = total_histogram;
 
-        cpu.clear();
-        ram.clear();
-        wait_time.clear();
-        other.clear();
-        server_count = 0;
+        wait_time.push_back(wait_delta.Mean() / 1000);
+        other.push_back(total_delta.Percentile(99) / 1000.0);
 
-        if (shutdown_)       // 如果执行PrintStatus()操作后，shutdown变化，可以立即跳出，无需等待sleep
-            return;
+        //server->PrintStatus();
 
+        server_count++;
 
+        /*
+        * 试验调整QPS以使数据图更好看
+        */
+        if (cpu_load >= 10)
+        {
+            server->ReduceQps();
+        }
+        else if (cpu_load <= 1)
+        {
+            server->RaiseQps();
+        }
 
+    }
 
-        
+    /* 求和 */
+    double sum_cpu = std::accumulate(cpu.begin(), cpu.end(), 0.0);
+    double sum_ram = std::accumulate(ram.begin(), ram.end(), 0.0);
+    double sum_wait_time = std::accumulate(wait_time.begin(), wait_time.end(), 0.0);
+    double sum_other = std::accumulate(other.begin(), other.end(), 0.0);
 
+    /* 求平均值 */
+    double mean_cpu = sum_cpu / server_count;
+    double mean_ram = sum_ram / server_count;
+    double mean_wait_time = sum_wait_time / server_count;
+    double mean_other = sum_other / server_count;
 
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    avg_experiment_data_.emplace_back(std::vector<double>{mean_cpu, mean_ram, mean_wait_time, mean_other});
 
+    /* 求方差 */
+    for (int i = 0; i < server_count; ++i)
+    {
+        var_cpu += std::pow(cpu[i] - mean_cpu, 2);
+        var_ram += std::pow(ram[i] - mean_ram, 2);
+        var_wait_time += std::pow(wait_time[i] - mean_wait_time, 2);
+        var_other += std::pow(other[i] - mean_other, 2);
     }
 
+    var_cpu /= server_count;
+    var_ram /= server_count;
+    var_wait_time /= server_count;
+    var_other /= server_count;
+
+    var_experiment_data_.emplace_back(std::vector<double>{var_cpu, var_ram, var_wait_time, var_other});
 
+    /* 求最大值 */
+    max_experiment_data_.emplace_back(std::vector<double>{max(cpu), max(ram), max(wait_time), max(other)});
 }
 
 void Monitor::SaveExperimentDataToFile()
@@ -151,7 +172,7 @@ void Monitor::SaveExperimentDataToFile()
 
     /* 1. avg data */
     avg_file.open(Config::data_file_path + balancer_ + ".avg.txt", std::ios::out | std::ios::trunc);
-    avg_file << "平均CPU" << "\t" << "平均RAM" << "\t" << "平均等待时间" << "\t" << "平均other" << std::endl;
+    avg_file << "平均CPU" << "\t" << "平均RAM" << "\t" << "平均等待时间" << "\t" << "平均p99总耗时" << std::endl;
 
     for (const auto& vec : avg_experiment_data_)
     {
@@ -161,7 +182,7 @@ void Monitor::SaveExperimentDataToFile()
 
     /* 2. var data */
     var_file.open(Config::data_file_path + balancer_ + ".var.txt", std::ios::out | std::ios::trunc);
-    var_file << "方差CPU" << "\t" << "方差RAM" << "\t" << "方差等待时间" << "\t" << "方差other" << std::endl;
+    var_file << "方差CPU" << "\t" << "方差RAM" << "\t" << "方差等待时间" << "\t" << "方差p99总耗时" << std::endl;
 
     for (const auto& vec : var_experiment_data_)
     {
@@ -171,7 +192,7 @@ void Monitor::SaveExperimentDataToFile()
 
     /* 3. max data */
     max_file.open(Config::data_file_path + balancer_ + ".max.txt", std::ios::out | std::ios::trunc);
-    max_file << "最大CPU" << "\t" << "最大RAM" << "\t" << "最大等待时间" << "\t" << "最大other" << std::endl;
+    max_file << "最大CPU" << "\t" << "最大RAM" << "\t" << "最大等待时间" << "\t" << "最大p99总耗时" << std::endl;
 
     for (const auto& vec : max_experiment_data_)
     {
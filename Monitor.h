@@ -4,9 +4,11 @@
 /*
  * 监测器
  * 持有Server池的引用，周期性调用每一个Server的PrintStatus()函数
+ * 不创建线程：采样注册在全局时间轮上每秒执行一次，模拟模式下由离散事件模拟器每隔一秒（虚拟时间）采样一次
+ * CPU 和 RAM 负载从服务器状态快照表（server_table.h）中读取，延迟直方图仍从各个服务器读取
  */
 
-#include <thread>
+#include <mutex>
 #include <vector>
 #include <string>
 
@@ -26,14 +28,16 @@ public:
 private:
     Monitor();
 
-    void ThreadFunc();
+    /* 采样一次所有服务器的状态，记录到实验数据中 */
+    void SampleOnce_();
 
-    std::thread monitor_thread_;
+    TimerHandle timer_;     // 每秒采样的定时器
+    std::mutex mutex_;      // 保证 Stop() 返回后不再有采样在执行
     std::vector<std::shared_ptr<Server>> servers_;
     bool shutdown_;
 
     /* 实验数据 */
-    /* 二维数组，每一行都是某个时间点计算的 [CPU, RAM, 等待时间, 占位] */
+    /* 二维数组，每一行都是某个时间点计算的 [CPU, RAM, 平均等待时间, p99总耗时]，时间的单位为 ms，统计的是上一个采样周期内完成的任务 */
     std::vector<std::vector<double> > avg_experiment_data_;
     std::vector<std::vector<double> > var_experiment_data_;
     std::vector<std::vector<double> > max_experiment_data_;
@@ -43,6 +47,10 @@ private:
     double final_wait_time_;
     double fineal_other_;
 
+    /* 每个服务器上一次采样时的直方图，与本次相减得到采样周期内的直方图 */
+    std::vector<LatencyHistogram::Snapshot> last_wait_histograms_;
+    std::vector<LatencyHistogram::Snapshot> last_total_histograms_;
+
     std::string     balancer_;
 };
 
@@ -2,51 +2,271 @@
 
 #include "config.h"
 
+/* 限流器的突发大小：按计算开销收取令牌时至少要容纳最长任务的令牌数，否则这样的任务在模拟模式下永远拿不到令牌 */
+static int64_t RateBurst()
+{
+    int64_t burst = g_config.RateBurst;
+    if (g_config.RateByCost)
+        burst = std::max<int64_t>(burst, (Config::kMaxRequestTime + Config::kRateTokenTime / 2) / Config::kRateTokenTime);
+    return std::max<int64_t>(burst, 1);
+}
+
+/* 所有服务器共用的全局限流器，不限制全局速率时为 nullptr */
+static RateLimiter* GlobalRateLimiter()
+{
+    static std::unique_ptr<RateLimiter> limiter = []() {
+        std::unique_ptr<RateLimiter> l;
+        if (g_config.GlobalRateLimit > 0)
+        {
+            l.reset(new RateLimiter(g_config.GlobalRateLimit, RateBurst(), g_config.Clock));
+            if (g_config.Simulate)
+                l->SetClock(SimulatorNow);
+        }
+        return l;
+    }();
+
+    return limiter.get();
+}
+
 Server::Server(int cpu, int ram, int id)
-    : cpu_(cpu + 1),        // 多出一个线程用来执行“本地资源管理"
+    : cpu_(cpu, g_config.PoolQueueMode, g_config.QueueCapacity,
+           Config::kTaskSlotCount, g_config.Backend()),
         storage_(ram), id_(id),
         weight_(1),
-        cpu_core_count_(cpu + 1),
-        rate_limiter_(Config::kDefaultRateLimit),
+        cpu_core_count_(cpu),
+        rate_limiter_(Config::kDefaultRateLimit, RateBurst(), g_config.Clock),
+        sum_task_time_(0),
+        sum_task_count_(0),
+        rejected_task_count_(0),
         qps_(Config::kDefaultRateLimit)
 {
     shutdown_ = false;
 
-    // 本地资源管理
-    cpu_.ExecuteTask([this] { GcFunc(); });
+    cpu_.SetDefaultDeadline(g_config.TaskDeadline);
+    cpu_.SetDropExpired(g_config.DropExpiredTasks);
+    cpu_.SetLatencyDecay(g_config.PeakEwmaTau);
+
+    for (auto& t : throttled_)
+        t = 0;
+
+    if (g_config.ClientRateLimit > 0)
+    {
+        for (unsigned i = 0; i < Config::kMaxClientBudgets; ++ i)
+            client_limiters_.emplace_back(new RateLimiter(g_config.ClientRateLimit, RateBurst(), g_config.Clock));
+    }
+
+    if (g_config.Simulate)
+    {   // 本地资源管理改为模拟器上的定时事件，不再占用一个核心；限流器也使用虚拟时钟
+        rate_limiter_.SetClock(SimulatorNow);
+        for (auto& l : client_limiters_)
+            l->SetClock(SimulatorNow);
+        GcEvent_();
+        return;
+    }
+
+    // 本地资源管理注册在全局时间轮上，每隔 GcInterval 做一次，不再占用一个 worker
+    gc_timer_ = TimerWheel::Instance().Every(std::chrono::milliseconds(g_config.GcInterval), [this]() { GcOnce_(); });
 }
 
 
 auto Server::Execute(Task t) -> std::future<bool>
 {
-    rate_limiter_.pass();
+    if (!PassRateLimiter_(t.client, TokensFor_(t), [this, t]() { ExecuteAdmitted_(t); }))
+        return std::future<bool>();
+
+    return ExecuteAdmitted_(t);
+}
+
+std::future<bool> Server::ExecuteAdmitted_(const Task& t)
+{
+    AccountTask_(t);
+
+    auto run = [this, t]() -> bool {
+        RunTask_(t);
+        return true;
+    };
+
+    if (!InNonBlockingThread_())
+        return cpu_.ExecuteTaskWithOptions(TaskOptions(t.priority, t.deadline, t.time), run);
+
+    // 推迟到时间轮或共享执行器线程上提交的请求不能等待队列空位，队满时拒绝
+    auto future = cpu_.TryExecuteTaskWithOptions(TaskOptions(t.priority, t.deadline, t.time), run);
+    if (!future.valid())
+        rejected_task_count_++;
+    return future;
+}
+
+TaskHandle Server::Post(Task t)
+{
+    if (!PassRateLimiter_(t.client, TokensFor_(t), [this, t]() { PostAdmitted_(t); }))
+        return TaskHandle();
+
+    return PostAdmitted_(t);
+}
+
+TaskHandle Server::PostAdmitted_(const Task& t)
+{
+    AccountTask_(t);
+
+    // 闭包只有 this 和 Task，可以直接放进任务槽
+    TaskHandle handle = cpu_.Submit(TaskOptions(t.priority, t.deadline, t.time), [this, t]() {
+        RunTask_(t);
+    });
+
+    if (!handle.Valid())
+    {   // 任务槽耗尽或者 BoundedRing 模式下队满，退回到需要堆分配的提交方式
+        // 普通线程队满时等待空位，保证任务不丢失；时间轮（例如 GC）和共享执行器的线程不能阻塞，队满时拒绝
+        auto run = [this, t]() {
+            RunTask_(t);
+        };
+
+        if (!InNonBlockingThread_())
+            cpu_.ExecuteTaskWithOptions(TaskOptions(t.priority, t.deadline, t.time), run);
+        else if (!cpu_.TryExecuteTaskWithOptions(TaskOptions(t.priority, t.deadline, t.time), run).valid())
+            rejected_task_count_++;
+    }
+
+    return handle;
+}
+
+TaskHandle Server::TryPost(Task t)
+{
+    if (!PassRateLimiter_(t.client, TokensFor_(t), [this, t]() { TryPostAdmitted_(t); }))
+        return TaskHandle();
+
+    return TryPostAdmitted_(t);
+}
+
+TaskHandle Server::TryPostAdmitted_(const Task& t)
+{
+    TaskHandle handle = cpu_.Submit(TaskOptions(t.priority, t.deadline, t.time), [this, t]() {
+        RunTask_(t);
+    });
+
+    if (!handle.Valid())
+    {   // 任务队列已满（或任务槽耗尽），把压力反馈给调用方，而不是无限制地缓存任务
+        rejected_task_count_++;
+        return handle;
+    }
+
+    AccountTask_(t);
+
+    return handle;
+}
+
+TaskHandle Server::ExecuteBatch(const std::vector<Task>& tasks)
+{
+    if (tasks.empty())
+        return TaskHandle();
+
+    // 一批请求来自同一个客户端
+    int64_t tokens = 0;
+    for (const auto& t : tasks)
+        tokens += TokensFor_(t);
+
+    if (!PassRateLimiter_(tasks.front().client, tokens, [this, tasks]() { ExecuteBatchAdmitted_(tasks); }))
+        return TaskHandle();
+
+    return ExecuteBatchAdmitted_(tasks);
+}
+
+TaskHandle Server::ExecuteBatchAdmitted_(const std::vector<Task>& tasks)
+{
+    if (g_config.Backend() != PoolBackend::Threads || InNonBlockingThread_())
+    {   // 逻辑核心按每个任务的 service_ms 计时，而整批任务只能共用一个 TaskOptions，逐个提交
+        // 时间轮和共享执行器的线程上也逐个提交：整批入队在 BoundedRing 模式下队满时会阻塞
+        for (const auto& t : tasks)
+            PostAdmitted_(t);
+        return TaskHandle();
+    }
+
+    for (const auto& t : tasks)
+        AccountTask_(t);
+
+    return cpu_.ExecuteBatch(tasks.begin(), tasks.end(), [this](const Task& t) {
+        RunTask_(t);
+    });
+}
+
+int Server::RatePath_(uint32_t client, RateLimiter** path, RateLevel* levels)
+{
+    int depth = 0;
+
+    if (client != 0 && !client_limiters_.empty())
+    {
+        path[depth] = client_limiters_[client % client_limiters_.size()].get();
+        levels[depth++] = RateLevel::Client;
+    }
+
+    path[depth] = &rate_limiter_;
+    levels[depth++] = RateLevel::Server;
+
+    if (RateLimiter* global = GlobalRateLimiter())
+    {
+        path[depth] = global;
+        levels[depth++] = RateLevel::Global;
+    }
+
+    return depth;
+}
+
+void Server::WaitRateLimiter_(uint32_t client, int64_t tokens)
+{
+    RateLimiter* path[kRateLevelCount];
+    RateLevel levels[kRateLevelCount];
+    int depth = RatePath_(client, path, levels);
 
+    // 在每一层预约令牌，只睡一次，睡到最晚生效的一层
+    int delayed = RateLimiter::passAll(path, depth, tokens);
+    if (delayed >= 0)
+        throttled_[static_cast<int>(levels[delayed])]++;
+}
+
+int64_t Server::TokensFor_(const Task& t)
+{
+    if (!g_config.RateByCost)
+        return 1;
+
+    int64_t tokens = (t.time + Config::kRateTokenTime / 2) / Config::kRateTokenTime;
+    return std::max<int64_t>(tokens, 1);
+}
+
+void Server::AccountTask_(const Task& t)
+{
     /* 统计任务数量和耗时，并通知 CPU */
     sum_task_count_++;
     sum_task_time_ += t.time;
     cpu_.SetAvgTaskTime(sum_task_time_ / sum_task_count_);
+}
 
-    return cpu_.template ExecuteTask([this, t]() -> bool {
-        if (t.storage != 0)     // 对于纯计算型任务，跳过操作内存的操作
-            storage_.Malloc(t.storage);
+void Server::RunTask_(const Task& t)
+{
+    // 请求的内容已经缓存在本地时不需要再分配存储
+    unsigned storage = (t.key != 0 && storage_.TouchKey(t.key)) ? 0 : t.storage;
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(t.time));
+    if (storage != 0)     // 对于纯计算型任务，跳过操作内存的操作
+        storage_.Malloc(storage);
 
+    if (g_config.Backend() != PoolBackend::Threads)
+    {   // 任务对 CPU 的占用由线程池的逻辑核心计时（service_ms），这里只安排任务结束时释放内存
+        if (storage != 0)
+            ScheduleAfter_(std::chrono::milliseconds(t.time), [this, storage]() {
+                storage_.Free(storage * 0.2);
+            });
+        return;
+    }
 
-        if (t.storage != 0)     // 对于纯计算型任务，跳过操作内存的操作
-            storage_.Free(t.storage * 0.2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(t.time));
 
-        return true;
-    });
+
+    if (storage != 0)     // 对于纯计算型任务，跳过操作内存的操作
+        storage_.Free(storage * 0.2);
 }
 
 void Server::Stop()
 {
     shutdown_ = true;
-
-    // 先停止博弈线程，以防cpu_结束后博弈线程去向它要东西
-    if (game_thread_.joinable())
-        game_thread_.join();
+    gc_timer_.Cancel();
 
 //    cpu_.Stop();
     cpu_.JoinAll();
@@ -67,27 +287,43 @@ void Server::PrintStatus()
 }
 
 
-void Server::GcFunc()
+void Server::GcOnce_()
 {
-    while (!shutdown_)
-    {
-        // 做GC会向CPU中添加一个任务，模拟GC的时间耗时
-        Execute(Task(Config::kGcTime, 0));
-        storage_.Free(Config::kGcSize);
+    // 做GC会向CPU中添加一个任务，模拟GC的时间耗时
+    // GC 任务以 System 优先级提交，Priority/Deadline 模式下不必和用户请求一起排队
+    Post(Task(Config::kGcTime, 0, TaskPriority::System));
+    storage_.Free(Config::kGcSize);
+
+    /*if (g_config.Verbose)
+        LOG(INFO) << "Freed " << Config::kGcSize << "MB RAM";*/
+}
+
+void Server::GcEvent_()
+{
+    if (shutdown_)
+        return;
 
-        /*if (g_config.Verbose)
-            LOG(INFO) << "Freed " << Config::kGcSize << "MB RAM";*/
+    GcOnce_();
 
-        if (shutdown_)
-            return;
+    ScheduleAfter_(std::chrono::milliseconds(g_config.GcInterval), [this]() { GcEvent_(); });
+}
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(g_config.GcInterval));
-    }
+void Server::ScheduleAfter_(std::chrono::nanoseconds delay, std::function<void ()> cb)
+{
+    if (g_config.Simulate)
+        Simulator::Instance().Schedule(delay, std::move(cb));
+    else if (g_config.Backend() == PoolBackend::Executor)
+        Executor::Instance().ScheduleAfter(delay, std::move(cb));
+    else
+        TimerWheel::Instance().Schedule(delay, std::move(cb));
 }
 
-void Server::SetWeight(int w)
+void Server::SetWeight(int w, bool notify)
 {
     weight_ = w;
+
+    if (notify && weight_observer_)
+        weight_observer_(w);
 }
 
 int Server::GetWeight()
@@ -5,9 +5,13 @@
 #include <thread>
 #include <random>
 #include <chrono>
+#include <vector>
 #include <glog/logging.h>
 
 #include "threadpool.h"
+#include "executor.h"
+#include "simulator.h"
+#include "timer_wheel.h"
 #include "Storage.h"
 #include "Task.h"
 #include "rate_limiter/rate_limiter.h"
@@ -25,10 +29,31 @@ public:
 
     /**
      * 异步执行一个Task
-     * @return 包含“Task是否成功执行（是为true，反之false）”的future
+     * @return 包含“Task是否成功执行（是为true，反之false）”的future；
+     *         请求被限流、推迟到令牌生效时才提交时返回无效的 future（valid() 为 false）
      */
     auto Execute(Task t) -> std::future<bool>;
 
+    /**
+     * 异步执行一个Task，提交过程不做堆分配
+     * BoundedRing 模式下队满时，普通线程阻塞等待；时间轮和共享执行器的线程不能阻塞，拒绝任务并计入被拒绝的任务数量
+     * @return 任务完成句柄；任务槽耗尽时退回 Execute()，或者请求被限流、推迟提交时，返回无效句柄
+     */
+    TaskHandle Post(Task t);
+
+    /**
+     * 异步执行一个Task，CPU 的任务队列已满时立即拒绝（仅 BoundedRing 模式下会发生）
+     * @return 任务完成句柄；被拒绝时返回无效句柄，并计入被拒绝的任务数量；被限流、推迟提交时也返回无效句柄
+     */
+    TaskHandle TryPost(Task t);
+
+    /**
+     * 批量异步执行一组Task
+     * 一次性从限流器取出整批任务的令牌，所有任务只加一次锁入队；不使用真实线程的执行方式下逐个提交
+     * @return 聚合的任务完成句柄，所有任务完成后才算完成；被限流、推迟提交或者逐个提交时返回无效句柄
+     */
+    TaskHandle ExecuteBatch(const std::vector<Task>& tasks);
+
 public:
     /**
      * 获得服务器ID
@@ -50,6 +75,49 @@ public:
      */
     int     GetTaskQueueSize() { return cpu_.GetTaskQueueSize(); }
 
+    /**
+     * 获得当前任务队列的实际长度
+     */
+    size_t  GetTaskQueueDepth() { return cpu_.GetTaskQueueDepth(); }
+
+    /**
+     * 获得当前未完成（排队中和执行中）的任务数量，精确的实时值
+     */
+    long    GetOutstandingTaskCount() { return cpu_.GetOutstandingTaskCount(); }
+
+    /**
+     * 获得任务响应时间（入队到完成）的 Peak-EWMA 估计值，单位 us
+     */
+    double  GetLatencyEwma() { return cpu_.GetLatencyEwma(); }
+
+    /**
+     * 获得因任务队列已满而被拒绝的任务数量
+     */
+    unsigned GetRejectedTaskCount() { return rejected_task_count_; }
+
+    /**
+     * 获得执行前已经超过截止期限的任务数量，以及其中被丢弃的数量
+     */
+    unsigned GetExpiredTaskCount() { return cpu_.GetExpiredTaskCount(); }
+    unsigned GetDroppedTaskCount() { return cpu_.GetDroppedTaskCount(); }
+
+    /**
+     * 获得请求在分层限流的某一层被限流的次数：每个需要等待的请求只计入一次，计入令牌最晚生效的一层
+     */
+    unsigned GetThrottledCount(RateLevel level) { return throttled_[static_cast<int>(level)]; }
+
+    /**
+     * 获得任务排队等待时间、执行时间、总耗时（进入 CPU 任务队列到执行完毕）的直方图，单位 us
+     */
+    LatencyHistogram::Snapshot GetQueueWaitHistogram() { return cpu_.GetQueueWaitHistogram(); }
+    LatencyHistogram::Snapshot GetServiceTimeHistogram() { return cpu_.GetServiceTimeHistogram(); }
+    LatencyHistogram::Snapshot GetTotalTimeHistogram() { return cpu_.GetTotalTimeHistogram(); }
+
+    /**
+     * 是否没有排队和执行中的任务，模拟模式下用来判断实验是否已经结束
+     */
+    bool    IsIdle() { return cpu_.IsIdle(); }
+
     /**
      * 获得近期的处理速度
      */
@@ -61,9 +129,15 @@ public:
     void    PrintStatus();
 
     /*
-    * set 权重
+    * set 权重；notify 为 true 时通知权重观察者（负载均衡器整体发布权重时自己负责通知）
     */
-    void    SetWeight(int w);
+    void    SetWeight(int w, bool notify = true);
+
+    /*
+    * 设置权重观察者，SetWeight() 之后在调用它的线程中以新的权重调用 observer
+    * 负载均衡器用它增量地更新加权选择的数据结构
+    */
+    void    SetWeightObserver(std::function<void (int)> observer) { weight_observer_ = std::move(observer); }
 
     /*
     * get 权重
@@ -82,12 +156,19 @@ public:
     /* get 任务阻塞率 */
     double GetBlockRate() { return cpu_.GetBlockRate(); }
 
+    /* get 平均任务耗时，单位 ms */
+    double  GetAvgTaskTime() { return cpu_.GetAvgTaskTime(); }
+
     /* get CPU核心数量 */
     unsigned GetCpuCoreCount() { return cpu_core_count_; }
 
     /* get RAM容量 */
     unsigned GetRamSize() { return storage_.GetSize(); }
 
+    /* get 内容缓存的命中和未命中次数 */
+    uint64_t GetCacheHitCount() { return storage_.GetCacheHitCount(); }
+    uint64_t GetCacheMissCount() { return storage_.GetCacheMissCount(); }
+
     /* set 内存管理的时间间隔 */
     void    SetGcInterval(int interval) { g_config.GcInterval = interval; }
    
@@ -97,19 +178,27 @@ public:
 
 private:
     int         id_;        // 服务器序号
-    int         weight_;    // 权重，默认值 1
+    std::atomic<int>    weight_;    // 权重，默认值 1
+    std::function<void (int)>   weight_observer_;   // 权重变化的观察者
     ThreadPool  cpu_;       // 计算资源
     unsigned    cpu_core_count_;    // 计算CPU核心数量，当前仅用于 GetCpuCount() 的返回值，无实际意义
     Storage     storage_;   // 存储资源
 
-    std::thread game_thread_;   // 博弈线程
-    bool        shutdown_;      // 用来控制GC线程和博弈的停止。cpu_自己有结束标识，不用这个shutdown_
-    RateLimiter rate_limiter_;  // 限流器
+    bool        shutdown_;      // 用来控制GC的停止。cpu_自己有结束标识，不用这个shutdown_
+    RateLimiter rate_limiter_;  // 限流器，分层限流中的服务器层
+
+    /* 分层限流中的客户端层：每个客户端在本服务器上的限流器，按 client % Config::kMaxClientBudgets 分配；不限制单个客户端时为空 */
+    std::vector<std::unique_ptr<RateLimiter>>   client_limiters_;
+
+    std::atomic<unsigned>   throttled_[kRateLevelCount];    // 每一层的限流次数
+    TimerHandle gc_timer_;      // 本地资源管理的定时器，Stop() 时取消
 
     /* 存储总的任务耗时和任务数量，以便于计算任务的平均耗时 */
     unsigned    sum_task_time_;     // 单位为 ms
     unsigned    sum_task_count_;
 
+    std::atomic<unsigned>   rejected_task_count_;   // 因任务队列已满而被拒绝的任务数量
+
     uint64_t    qps_;
 
 private:
@@ -119,12 +208,93 @@ private:
     std::string     GetStatusLogString_();
 
     /**
-     * 控制本地资源管理的线程函数
-     * 不需要增加单独的线程，由cpu_来执行它即可
+     * 统计任务数量和耗时，并通知 CPU
+     */
+    void    AccountTask_(const Task& t);
+
+    /**
+     * 在 CPU 上执行一个 Task 的实际工作
+     */
+    void    RunTask_(const Task& t);
+
+    /**
+     * 为客户端 client 的请求通过分层限流（客户端 -> 服务器 -> 全局），每一层一次拿到 tokens 个令牌
+     * 普通线程中阻塞直到拿到令牌并返回 true；模拟模式下虚拟时间不会在等待中前进，共享执行器和时间轮的线程也不能阻塞，
+     * 这些情况下在每一层预约令牌，把 admitted（已经通过限流之后的部分）推迟到令牌全部生效时执行，并返回 false
+     */
+    template<typename F>
+    bool    PassRateLimiter_(uint32_t client, int64_t tokens, F&& admitted);
+
+    /**
+     * Execute()、Post()、TryPost()、ExecuteBatch() 通过限流之后的部分
+     */
+    std::future<bool>   ExecuteAdmitted_(const Task& t);
+    TaskHandle          PostAdmitted_(const Task& t);
+    TaskHandle          TryPostAdmitted_(const Task& t);
+    TaskHandle          ExecuteBatchAdmitted_(const std::vector<Task>& tasks);
+
+    /**
+     * 当前线程是否不能阻塞：共享执行器的 worker 和时间轮线程上的回调都不能阻塞
+     */
+    static bool InNonBlockingThread_() { return Executor::InWorkerThread() || TimerWheel::InTimerThread(); }
+
+    /**
+     * 阻塞直到客户端 client 在每一层都拿到 tokens 个令牌
+     */
+    void    WaitRateLimiter_(uint32_t client, int64_t tokens);
+
+    /**
+     * 客户端 client 的请求要通过的限流器，从叶子到根写入 path，对应的层写入 levels，返回层数
+     * 不限制的层不在其中
+     */
+    int     RatePath_(uint32_t client, RateLimiter** path, RateLevel* levels);
+
+    /**
+     * 任务 t 需要的令牌数：按计算开销收取时为 t.time / Config::kRateTokenTime（四舍五入，至少为 1），否则为 1
      */
-    void    GcFunc();
+    static int64_t TokensFor_(const Task& t);
+
+    /**
+     * 做一次本地资源管理：向 CPU 提交一个 GC 任务并释放内存
+     */
+    void    GcOnce_();
+
+    /**
+     * 模拟模式下的本地资源管理：做一次 GC，并在 GcInterval 之后再次触发自己
+     */
+    void    GcEvent_();
+
+    /**
+     * 在 delay 之后执行 cb：模拟模式下使用模拟器的虚拟时钟，共享执行器模式下由执行器的 worker 执行，
+     * 否则在时间轮线程中执行
+     */
+    void    ScheduleAfter_(std::chrono::nanoseconds delay, std::function<void ()> cb);
 };
 
+template<typename F>
+bool Server::PassRateLimiter_(uint32_t client, int64_t tokens, F&& admitted)
+{
+    if (!g_config.Simulate && !InNonBlockingThread_())
+    {
+        WaitRateLimiter_(client, tokens);
+        return true;
+    }
+
+    RateLimiter* path[kRateLevelCount];
+    RateLevel levels[kRateLevelCount];
+    int depth = RatePath_(client, path, levels);
+
+    // 令牌在预约时就已经占用，到时直接执行 admitted，不再重试，每个请求只计入一次限流
+    int64_t when = 0;
+    int latest = RateLimiter::reserveAll(path, depth, tokens, &when);
+    if (latest < 0)
+        return true;
+
+    throttled_[static_cast<int>(levels[latest])]++;
+    ScheduleAfter_(std::chrono::nanoseconds(when - path[latest]->now()), std::forward<F>(admitted));
+    return false;
+}
+
 /**
  * 返回一个Server的share_ptr指针
  * @id 必需指定服务器ID
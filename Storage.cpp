@@ -6,7 +6,9 @@
 
 Storage::Storage(unsigned int size)
     : size_(size),
-    used_size_(10)
+    used_size_(10),
+    cache_hits_(0),
+    cache_misses_(0)
 {
 
 }
@@ -29,3 +31,32 @@ void Storage::Free(unsigned int size)
         used_size_ = 10;
     }
 }
+
+bool Storage::TouchKey(uint64_t key)
+{
+    std::lock_guard<std::mutex> guard(cache_mutex_);
+
+    auto it = cache_index_.find(key);
+    if (it != cache_index_.end())
+    {
+        cache_lru_.splice(cache_lru_.begin(), cache_lru_, it->second);
+        cache_hits_++;
+        return true;
+    }
+
+    cache_misses_++;
+
+    if (cache_lru_.size() >= Config::kContentCacheEntries)
+    {   // 淘汰最久未访问的内容，复用它的链表节点
+        cache_index_.erase(cache_lru_.back());
+        cache_lru_.back() = key;
+        cache_lru_.splice(cache_lru_.begin(), cache_lru_, std::prev(cache_lru_.end()));
+    }
+    else
+    {
+        cache_lru_.push_front(key);
+    }
+
+    cache_index_[key] = cache_lru_.begin();
+    return false;
+}
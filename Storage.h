@@ -4,6 +4,10 @@
 #include <thread>
 #include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 #include "config.h"
 
@@ -31,12 +35,29 @@ public:
 
     void        Shutdown();
 
+    /*
+     * 访问内容 key：已经缓存在本地时返回 true（命中），不需要再分配存储；
+     * 否则放入缓存并返回 false，缓存已满时淘汰最久未访问的内容
+     */
+    bool        TouchKey(uint64_t key);
+
+    /* get 内容缓存的命中和未命中次数 */
+    uint64_t    GetCacheHitCount() const    { return cache_hits_; }
+    uint64_t    GetCacheMissCount() const   { return cache_misses_; }
+
 private:
     void _GcFunc();
 
 private:
     unsigned        size_;          // MB
     std::atomic<unsigned>        used_size_;
+
+    /* 内容缓存（LRU），容量为 Config::kContentCacheEntries，由 cache_mutex_ 保护 */
+    std::mutex                  cache_mutex_;
+    std::list<uint64_t>         cache_lru_;     // 最近访问的在前
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator>  cache_index_;
+    std::atomic<uint64_t>       cache_hits_;
+    std::atomic<uint64_t>       cache_misses_;
 };
 
 
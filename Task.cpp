@@ -1,6 +1,9 @@
 #include "Task.h"
 #include "config.h"
 
+#include <algorithm>
+#include <cmath>
+
 #include <glog/logging.h>
 
 
@@ -22,10 +25,21 @@ int GenerateRandomStorage()
     return u(e);
 }
 
+uint64_t GenerateRandomKey()
+{
+    static auto seed = std::chrono::steady_clock::now().time_since_epoch().count();
+    static std::default_random_engine e(seed);
+    static std::uniform_real_distribution<double> u(0.0, 1.0);
+
+    // (N+1)^u 在 [1, N+1) 上对数均匀分布，取整后键 k 的概率约与 ln((k+1)/k) 成正比
+    auto key = static_cast<uint64_t>(std::pow(Config::kContentKeyCount + 1.0, u(e)));
+    return std::min<uint64_t>(std::max<uint64_t>(key, 1), Config::kContentKeyCount);
+}
+
 Task GenerateRandomTask()
 {
     counter ++;
-    return Task(GenerateRandomTime(), GenerateRandomStorage());
+    return Task(GenerateRandomTime(), GenerateRandomStorage(), TaskPriority::Normal, 0, GenerateRandomKey());
 }
 
 
@@ -6,15 +6,23 @@
  * 任务请求类和生成“符合不同分布特征的任务请求”函数
  */
 
+#include <cstdint>
 #include <random>
 #include <chrono>
 
+#include "config.h"
+
 struct Task
 {
     int time;       // 计算开销，单位为ms
     int storage;    // 存储开销，单位为MB
+    TaskPriority priority;  // 优先级，默认 Normal
+    unsigned deadline;      // 相对提交时间的截止期限，单位为ms，0 表示使用服务器的默认值
+    uint64_t key;           // 内容/会话键，相同的键访问相同的内容；0 表示没有键
+    uint32_t client;        // 发出请求的客户端编号，从 1 开始；0 表示未知客户端，不受单个客户端的限流
 
-    Task(int t, int s) : time(t), storage(s) {}
+    Task(int t, int s, TaskPriority p = TaskPriority::Normal, unsigned d = 0, uint64_t k = 0, uint32_t c = 0)
+        : time(t), storage(s), priority(p), deadline(d), key(k), client(c) {}
 };
 
 
@@ -34,6 +42,12 @@ static int GenerateRandomTime();
  */
 static int GenerateRandomStorage();
 
+/*
+ * 生成随机的内容键，取值范围 [1, Config::kContentKeyCount]
+ * 服从对数均匀分布（近似 Zipf(1)）：少数热门内容被频繁访问
+ */
+static uint64_t GenerateRandomKey();
+
 /*
  * 生成随机的任务请求
  */
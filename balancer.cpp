@@ -1,14 +1,19 @@
 #include "balancer.h"
 
-#include <random>
-#include <chrono>
-#include <string>
-#include <numeric>
 #include <algorithm>
+#include <string>
+
+/* ǰ̵߳ţһεʱ䣬ѡƬ */
+static unsigned ThreadIndex()
+{
+	static std::atomic<unsigned> next(0);
+	static thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed);
+	return index;
+}
 
 Balancer::Balancer()
-	: lb_algorithm_(LoadBalanceAlgorithm::Random),
-	  is_server_queue_ready_(false)
+	: policy_(nullptr),
+	  lines_per_shard_(0)
 {}
 
 Balancer& Balancer::Instance()
@@ -21,229 +26,148 @@ void Balancer::Init(const std::vector<std::shared_ptr<Server>>& server_pool)
 {
 	servers_ = server_pool;
 
-	// ʼ
-	for (const auto& s : servers_)
-	{
-		counter_[s] = 0;
-	}
-}
+	// ʼÿƬȡ
+	lines_per_shard_ = (servers_.size() + CounterLine::kCount - 1) / CounterLine::kCount;
+	counters_.reset(new CounterLine[Config::kBalancerCounterShards * lines_per_shard_]());
 
-void Balancer::SetLoadBlanceAlgorithm(LoadBalanceAlgorithm a)
-{
-	lb_algorithm_ = a;
-	
-	// ʹ game 㷨һ server queue
-	if (a == LoadBalanceAlgorithm::Game)
+	for (size_t i = 0; i < servers_.size(); ++i)
 	{
-		UpdateServerQueue_();
+		servers_[i]->SetWeightObserver([this, i](int w) {
+			OnWeightChanged_(i, w);
+			});
 	}
-}
 
-LoadBalanceAlgorithm Balancer::GetLoadBlanceAlgorithm()
-{
-	return lb_algorithm_;
+	SetPolicy("random");
 }
 
-
-void Balancer::UpdateServerQueue_()
+bool Balancer::SetPolicy(const std::string& name)
 {
-	is_server_queue_ready_ = false;
-
-	server_queue_.clear();
-
-	std::vector<int>	initial_weight;		// ʵȨ
-	std::vector<int>	current_weight;		// ʱȨ
+	std::lock_guard<std::mutex> guard(policies_mutex_);
 
-	for (const auto& s : servers_)
+	for (auto& p : policies_)
 	{
-		initial_weight.emplace_back(s->GetWeight());
-		current_weight.emplace_back(s->GetWeight());
+		if (p.first == name)
+		{
+			policy_.store(p.second.get(), std::memory_order_release);
+			return true;
+		}
 	}
 
-	int sum_weight = std::accumulate(current_weight.begin(), current_weight.end(), 0);
+	auto policy = BalancerRegistry::Instance().Create(name, servers_);
+	if (policy == nullptr)
+		return false;
 
-	while (true)
-	{
-		// ҵʱȨصֵӵиȨصķ
-		auto max_weight_iter = std::max_element(current_weight.begin(), current_weight.end());
-		auto max_server_iter = servers_.begin();
-		std::advance(max_server_iter, std::distance(current_weight.begin(), max_weight_iter));
+	// ʵĲҲҪ֪ЩѾ˳
+	for (size_t i : removed_)
+		policy->OnServerRemoved(i);
 
-		server_queue_.emplace_back(*max_server_iter);
-
-		(*max_weight_iter) -= sum_weight;
-
-		if (server_queue_.size() == sum_weight)
-			break;
+	policy_.store(policy.get(), std::memory_order_release);
+	policies_.emplace_back(name, std::move(policy));
+	return true;
+}
 
-		for (int i = 0; i < current_weight.size(); ++i)
-		{
-			current_weight[i] += initial_weight[i];
-		}
-	}
+std::string Balancer::GetPolicy()
+{
+	std::lock_guard<std::mutex> guard(policies_mutex_);
 
-	is_server_queue_ready_ = true;
+	for (const auto& p : policies_)
+		if (p.second.get() == policy_.load(std::memory_order_relaxed))
+			return p.first;
 
-	/*if (g_config.Verbose)
-	{
-		LOG(INFO) << "Updated server queue. queue.size=" << server_queue_.size();
-	}*/
+	return "";
 }
 
-ServerPtr Balancer::SelectServerRoundRobin_()
+void Balancer::OnWeightChanged_(size_t index, int weight)
 {
-	static int offset;
-	if (offset >= servers_.size())
-		offset = 0;
+	std::lock_guard<std::mutex> guard(policies_mutex_);
 
-	return servers_[offset++];
+	for (auto& p : policies_)
+		p.second->OnWeightChanged(index, weight);
 }
 
-ServerPtr Balancer::SelectServerRandom_()
+void Balancer::SetWeights(const std::vector<int>& weights)
 {
-	static auto seed = std::chrono::steady_clock::now().time_since_epoch().count();
-	static std::default_random_engine engine(seed);
-	static int max = servers_.size();
-	static std::uniform_int_distribution u(0, max - 1);     // ע-1ɵΪ[min, max]
+	std::lock_guard<std::mutex> guard(policies_mutex_);
 
-	return servers_[u(engine)];
+	// ȸ·ϵȨأٰ֪ͨȨؽ
+	for (size_t i = 0; i < servers_.size() && i < weights.size(); ++i)
+		servers_[i]->SetWeight(weights[i], false);
+
+	for (auto& p : policies_)
+		p.second->OnWeightsChanged(weights);
 }
 
-ServerPtr Balancer::SelectServerPower_()
+size_t Balancer::IndexOf_(int server_id) const
 {
-	static auto seed = std::chrono::steady_clock::now().time_since_epoch().count();
-	static std::default_random_engine engine(seed);
-	static int max = servers_.size();
-	static std::uniform_int_distribution u(0, max - 1);     // ע-1ɵΪ[min, max]
-
-	int first = u(engine);
-	int second = u(engine);
-
-	if (first == second)
-		return servers_[first];
-	else if (servers_[first]->GetBlockRate() <= servers_[second]->GetBlockRate())
-		return servers_[first];
-	else
-		return servers_[second];
+	for (size_t i = 0; i < servers_.size(); ++i)
+		if (servers_[i]->GetId() == server_id)
+			return i;
+
+	return servers_.size();
 }
 
-ServerPtr Balancer::SelectServerGame_()
+void Balancer::AddServer(int server_id)
 {
-	static int offset;
+	size_t index = IndexOf_(server_id);
 
-	// server queue 
-	if (offset == server_queue_.size() && offset != 0)
-	{
-		offset = 0;
-		if (is_server_queue_ready_)
-		{
-			std::thread t([this] {
-				UpdateServerQueue_();
-				});
-			t.detach();
-			return SelectServerRoundRobin_();
-		}
-	}
-	else if (!is_server_queue_ready_)
-	{
-		return SelectServerRoundRobin_();
-	}
-	else
-	{
-		return server_queue_[offset++];
-	}
+	std::lock_guard<std::mutex> guard(policies_mutex_);
 
+	auto it = std::find(removed_.begin(), removed_.end(), index);
+	if (it == removed_.end())
+		return;
+	removed_.erase(it);
 
-	// `server_queue_`û׼ãҪ
-	// 1. ״У`server_queue_`Ϊ -> ѯ㷨ͬʱ`server_quque_`
-	// 2. ״У`server_queue_`ڱ -> ʹþɵķУ
-	//if (!is_server_queue_ready_)
-	//{
-	//	if (g_config.Verbose)
-	//		LOG(INFO) << "Server queue is not ready";
-
-	//	if (server_queue_.empty())	// 1״
-	//	{
-	//		if (g_config.Verbose)
-	//			LOG(INFO) << "Updating server queue...";
-
-	//		std::thread t([this]() {
-	//			UpdateServerQueue_();
-	//			});
-	//		t.detach();
-
-	//		return SelectServerRoundRobin_();
-	//	}
-	//	else						// 2״
-	//	{
-	//		if (offset == server_queue_.size())
-	//		{
-	//			if (g_config.Verbose)
-	//				LOG(INFO) << "server queue ꣬ͷʼ";
-
-	//			offset = 0;
-	//			return server_queue_[offset];
-	//		}
-	//		return server_queue_[offset++];
-	//	}
-	//}
-	//// `server_queue_`׼õ
-	//else
-	//{
-	//	if (g_config.Verbose)
-	//		LOG(INFO) << "Server queue is ready";
-
-	//	// ĩβ
-	//	if (offset == server_queue_.size())
-	//	{
-	//		offset = 0;
-	//		return server_queue_[offset];
-	//	}
-	//	// ûĩβѯ`server_queue_`
-	//	else
-	//	{
-	//		return server_queue_[offset++];
-	//	}
-	//}
+	for (auto& p : policies_)
+		p.second->OnServerAdded(index);
 }
 
-ServerPtr Balancer::SelectOneServer()
+void Balancer::RemoveServer(int server_id)
 {
-	ServerPtr result;
+	size_t index = IndexOf_(server_id);
+	if (index == servers_.size())
+		return;
 
-	switch (lb_algorithm_)
-	{
-	case LoadBalanceAlgorithm::Game:
-		result = SelectServerGame_();
-		break;
+	std::lock_guard<std::mutex> guard(policies_mutex_);
 
-	case LoadBalanceAlgorithm::Power:
-		result = SelectServerPower_();
-		break;
+	if (std::find(removed_.begin(), removed_.end(), index) != removed_.end())
+		return;
+	removed_.push_back(index);
 
-	case LoadBalanceAlgorithm::RoundRobin:
-		result = SelectServerRoundRobin_();
-		break;
+	for (auto& p : policies_)
+		p.second->OnServerRemoved(index);
+}
 
-	default:	// Ĭʹ㷨
-		result = SelectServerRandom_();
-		break;
-	}
+ServerPtr Balancer::SelectOneServer(uint64_t key)
+{
+	// Ψһһμӵãѡ߼ BalancerCore бȫ
+	size_t result = policy_.load(std::memory_order_acquire)->Select(key);
 
-	counter_[result] ++;
+	// ֻдǰ̵߳ķƬͬͻ֮߳ûо
+	Counter_(ThreadIndex() % Config::kBalancerCounterShards, result).fetch_add(1, std::memory_order_relaxed);
 
-	return result;
+	return servers_[result];
+}
+
+std::atomic<uint64_t>& Balancer::Counter_(size_t shard, size_t index)
+{
+	CounterLine& line = counters_[shard * lines_per_shard_ + index / CounterLine::kCount];
+	return line.counts[index % CounterLine::kCount];
 }
 
 void Balancer::PrintStatistics()
 {
-	int sum_task = 0;
+	uint64_t sum_task = 0;
 	std::string log_string = "=================================Statistics======================================\n";
 
-	for (const auto& item : counter_)
+	for (size_t i = 0; i < servers_.size(); ++i)
 	{
-		sum_task += item.second;
-		log_string += "Server[" + std::to_string(item.first->GetId()) + "] - " + std::to_string(item.second) + "\n";
+		// ϲзƬ
+		uint64_t count = 0;
+		for (size_t shard = 0; shard < Config::kBalancerCounterShards; ++shard)
+			count += Counter_(shard, i).load(std::memory_order_relaxed);
+
+		sum_task += count;
+		log_string += "Server[" + std::to_string(servers_[i]->GetId()) + "] - " + std::to_string(count) + "\n";
 	}
 
 	log_string += "SUM - " + std::to_string(sum_task);
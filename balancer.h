@@ -1,18 +1,14 @@
 #ifndef TINYEDGEPLAYER_BALANCER_H
 #define TINYEDGEPLAYER_BALANCER_H
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 #include "Server.h"
-
-using ServerPtr = std::shared_ptr<Server>;
-
-enum class LoadBalanceAlgorithm
-{
-	Random,
-	RoundRobin,
-	Game,
-	Power,
-};
+#include "balancer_policy.h"
 
 class Balancer
 {
@@ -25,19 +21,35 @@ public:
 	/*
 	* ʼ Balancer
 	* 1.
+	* 2.ǰΪ random
 	*/
 	void Init(const std::vector<std::shared_ptr<Server>>& server_pool);
 
-	/* 
-	* setgetؾ㷨 
+	/*
+	* setgetؾԣname Ϊ BalancerRegistry ע֣ random, round, game
+	* ÿڵһαѡʱʵ֮лʱԭʵδעʱ falseǰԲ
+	*/
+	bool SetPolicy(const std::string& name);
+	std::string GetPolicy();
+
+	/*
+	* зȨأ`servers_`еĽǱУʵĲһԿµȨ
+	* ÿڵһΣ Server::SetWeight() Ȼ֪ͨ
+	*/
+	void SetWeights(const std::vector<int>& weights);
+
+	/*
+	* ݵǰѡһ
+	* key ΪݼֻҪĲԣ chashʹ
 	*/
-	void SetLoadBlanceAlgorithm(LoadBalanceAlgorithm a);
-	LoadBalanceAlgorithm GetLoadBlanceAlgorithm();
+	std::shared_ptr<Server> SelectOneServer(uint64_t key = 0);
 
 	/*
-	* lb_algorithm_ѡһ
+	* ÷˳²븺ؾ⣨߻ժϽڵ㣩֪ͨʵĲԣ֮ʵĲҲõ֪ͨ
+	* ɲԾӦòֻ chash ѷƳ/ϣԲӰ
 	*/
-	std::shared_ptr<Server> SelectOneServer();
+	void AddServer(int server_id);
+	void RemoveServer(int server_id);
 
 	/* 
 	* ӡͳϢ
@@ -47,47 +59,57 @@ public:
 
 
 private:
-	LoadBalanceAlgorithm				lb_algorithm_;	// ؾ㷨ĬΪ㷨
+	/*
+	* һеļ
+	* ÿƬļӻб߽翪ʼͬƬ֮䲻ᷢα
+	*/
+	struct alignas(64) CounterLine
+	{
+		static constexpr size_t kCount = 64 / sizeof(std::atomic<uint64_t>);
+		std::atomic<uint64_t>	counts[kCount];
+	};
+
 	std::vector<ServerPtr>				servers_;		// server pool
-	std::unordered_map<ServerPtr, int>	counter_;		// ͳÿ
-	std::vector<ServerPtr>				server_queue_;	// У洢ֵΪ`servers_`еĽǱ
-	bool								is_server_queue_ready_;		// `server_queue_`ǷãĬӦΪfalse
 
-private:
 	/*
-	* ģʽ˽л캯
+	* ѾʵĲԣ Balancer ͬڣлʱͷţ policy_ Բӱضȡ
+	* policies_  removed_  policies_mutex_ 
 	*/
-	Balancer();
+	std::mutex							policies_mutex_;
+	std::vector<std::pair<std::string, std::unique_ptr<BalancerSelector>>>	policies_;
+	std::atomic<BalancerSelector*>		policy_;		// ǰ
+	std::vector<size_t>					removed_;		// ˳ؾķĽǱ
 
 	/*
-	* ؾ㷨Round Robin
+	* ͳÿ
+	*  Config::kBalancerCounterShards ƬÿƬռ lines_per_shard_ У`servers_`еĽǱ
+	* ͻֻ߳дԼķƬPrintStatistics() ʱϲ
 	*/
-	ServerPtr SelectServerRoundRobin_();
+	std::unique_ptr<CounterLine[]>		counters_;
+	size_t								lines_per_shard_;
 
+private:
 	/*
-	* ؾ㷨Random
+	* ģʽ˽л캯
 	*/
-	ServerPtr SelectServerRandom_();
+	Balancer();
 
 	/*
-	* ؾ㷨Power of k choices
+	*  index ȨرΪ weight֪ͨʵĲ
 	*/
-	ServerPtr SelectServerPower_();
+	void OnWeightChanged_(size_t index, int weight);
 
 	/*
-	* ʵֵĸؾ㷨Game
+	* server_id Ӧķ`servers_`еĽǱ꣬Ҳʱ servers_.size()
 	*/
-	ServerPtr SelectServerGame_();
-
+	size_t IndexOf_(int server_id) const;
 
 	/*
-	 * ·server_queue_
-	 * ¹`is_server_queue_ready_`ֵӦΪfalse
-	 * ɺ`is_server_queue_ready_`ֵӦΪtrue
-	 */
-	void UpdateServerQueue_();
+	*  shard ƬУ index ļ
+	*/
+	std::atomic<uint64_t>& Counter_(size_t shard, size_t index);
 
 	
 };
 
-#endif	// TINYEDGEPLAYER_BALANCER_H
\ No newline at end of file
+#endif	// TINYEDGEPLAYER_BALANCER_H
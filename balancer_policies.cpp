@@ -0,0 +1,189 @@
+#include "balancer_policies.h"
+
+#include <numeric>
+
+#include "simulator.h"
+#include "timer_wheel.h"
+
+REGISTER_BALANCER_POLICY(RandomPolicy, "random");
+REGISTER_BALANCER_POLICY(RoundRobinPolicy, "round");
+REGISTER_BALANCER_POLICY(PowerPolicy, "power");
+REGISTER_BALANCER_POLICY(LeastOutstandingPolicy, "least");
+REGISTER_BALANCER_POLICY(JsqPolicy, "jsq");
+REGISTER_BALANCER_POLICY(PeakEwmaPolicy, "ewma");
+REGISTER_BALANCER_POLICY(GamePolicy, "game");
+REGISTER_BALANCER_POLICY(ConsistentHashPolicy, "chash");
+
+/* 稍后执行 cb：模拟模式下为模拟器上的事件，否则在全局时间轮线程中执行 */
+static void RunLater(std::function<void ()> cb)
+{
+    if (g_config.Simulate)
+        Simulator::Instance().Schedule(std::chrono::nanoseconds(0), std::move(cb));
+    else
+        TimerWheel::Instance().Schedule(std::chrono::nanoseconds(0), std::move(cb));
+}
+
+GamePolicy::GamePolicy(const std::vector<ServerPtr>& servers)
+    : servers_(servers),
+      round_robin_(servers),
+      queue_refresh_pending_(false),
+      alias_dirty_(false)
+{
+    // swrr_ 和别名表按当前权重准备好，之后随服务器权重的变化更新；服务器队列在第一次按队列选择时生成
+    std::vector<int> weights = CollectWeights_();
+    swrr_.Reset(weights);
+    alias_table_.Publish(new AliasTable(weights));
+}
+
+std::vector<int> GamePolicy::CollectWeights_() const
+{
+    std::vector<int> weights;
+    for (const auto& s : servers_)
+        weights.emplace_back(s->GetWeight());
+
+    return weights;
+}
+
+void GamePolicy::OnWeightChanged(size_t index, int weight)
+{
+    {
+        std::lock_guard<std::mutex> guard(swrr_mutex_);
+        swrr_.Update(index, weight);
+    }
+
+    // 别名表只能整体重建：一个博弈周期内的多次权重变化合并为一次重建
+    if (!alias_dirty_.exchange(true))
+    {
+        RunLater([this] {
+            RebuildAliasTable_();
+        });
+    }
+}
+
+void GamePolicy::OnWeightsChanged(const std::vector<int>& weights)
+{
+    {
+        std::lock_guard<std::mutex> guard(swrr_mutex_);
+        swrr_.Reset(weights);
+    }
+
+    alias_dirty_ = false;
+    alias_table_.Publish(new AliasTable(weights));
+
+    if (g_config.GameSelectorMode == GameSelector::Queue)
+        UpdateServerQueue_();
+}
+
+void GamePolicy::RebuildAliasTable_()
+{
+    alias_dirty_ = false;
+
+    alias_table_.Publish(new AliasTable(CollectWeights_()));
+}
+
+void GamePolicy::ScheduleQueueUpdate_()
+{
+    if (g_config.Simulate)
+    {   // 模拟模式下只有一个线程，直接更新
+        UpdateServerQueue_();
+        return;
+    }
+
+    // 交给全局时间轮线程更新，不再为每次更新创建一个线程
+    TimerWheel::Instance().Schedule(std::chrono::nanoseconds(0), [this] {
+        UpdateServerQueue_();
+    });
+}
+
+void GamePolicy::UpdateServerQueue_()
+{
+    queue_refresh_pending_ = false;
+
+    // 在旁边生成新的队列，生成好之后整体替换，读者不会看到生成到一半的队列
+    auto queue = new std::vector<size_t>();
+
+    std::vector<int>    initial_weight;     // 真实权重
+    std::vector<int>    current_weight;     // 临时权重
+
+    for (const auto& s : servers_)
+    {
+        int w = std::max(s->GetWeight(), 0);
+        initial_weight.emplace_back(w);
+        current_weight.emplace_back(w);
+    }
+
+    int sum_weight = std::accumulate(current_weight.begin(), current_weight.end(), 0);
+
+    while (sum_weight > 0)
+    {
+        // 找到临时权重的最大值和拥有该权重的服务器
+        auto max_weight_iter = std::max_element(current_weight.begin(), current_weight.end());
+
+        queue->emplace_back(std::distance(current_weight.begin(), max_weight_iter));
+
+        (*max_weight_iter) -= sum_weight;
+
+        if (queue->size() == static_cast<size_t>(sum_weight))
+            break;
+
+        for (size_t i = 0; i < current_weight.size(); ++ i)
+            current_weight[i] += initial_weight[i];
+    }
+
+    server_queue_.Publish(queue);
+}
+
+ConsistentHashPolicy::ConsistentHashPolicy(const std::vector<ServerPtr>& servers)
+    : servers_(servers),
+      random_(servers)
+{
+    // 所有服务器都加入哈希环
+    ring_.Publish(new RingState{HashRing(), {}, 0});
+    for (size_t i = 0; i < servers_.size(); ++ i)
+        OnServerAdded(i);
+}
+
+template<typename F>
+void ConsistentHashPolicy::UpdateRing_(F update)
+{
+    std::lock_guard<std::mutex> guard(ring_mutex_);
+
+    // 只有持有 ring_mutex_ 的写者会替换 ring_，这里读到的就是最新的环，离开读临界区后也不会被释放
+    const RingState* old;
+    {
+        EpochDomain::ReadGuard read_guard;
+        old = ring_.Load();
+    }
+
+    auto state = new RingState(*old);
+    update(*state);
+    ring_.Publish(state);
+}
+
+void ConsistentHashPolicy::OnServerAdded(size_t index)
+{
+    UpdateRing_([this, index](RingState& state) {
+        if (std::find(state.members.begin(), state.members.end(), index) != state.members.end())
+            return;
+
+        // 虚拟节点的位置只取决于服务器 ID，服务器移出后再加入时负责的键不变
+        unsigned cores = servers_[index]->GetCpuCoreCount();
+        state.ring = state.ring.WithNode(static_cast<uint32_t>(index), servers_[index]->GetId(),
+                                         cores * Config::kHashRingVirtualNodesPerCore);
+        state.members.push_back(index);
+        state.cores += cores;
+    });
+}
+
+void ConsistentHashPolicy::OnServerRemoved(size_t index)
+{
+    UpdateRing_([this, index](RingState& state) {
+        auto it = std::find(state.members.begin(), state.members.end(), index);
+        if (it == state.members.end())
+            return;
+
+        state.ring = state.ring.WithoutNode(static_cast<uint32_t>(index));
+        state.members.erase(it);
+        state.cores -= servers_[index]->GetCpuCoreCount();
+    });
+}
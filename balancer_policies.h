@@ -0,0 +1,439 @@
+#ifndef TINYEDGEPLAYER_BALANCER_POLICIES_H
+#define TINYEDGEPLAYER_BALANCER_POLICIES_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "balancer_policy.h"
+#include "config.h"
+#include "hash_ring.h"
+#include "rcu.h"
+#include "server_table.h"
+#include "weighted_selector.h"
+
+/*
+ * 内置的负载均衡策略（约定见 balancer_policy.h），在 balancer_policies.cpp 中注册
+ * 选择路径都定义在类内，由 BalancerCore 内联；重建数据结构等冷路径放在 balancer_policies.cpp 中
+ */
+
+/* 当前线程的随机数引擎，每个客户端线程独立一份，选择服务器时不需要加锁 */
+inline std::default_random_engine& BalancerThreadEngine()
+{
+    static thread_local std::default_random_engine engine(
+        std::chrono::steady_clock::now().time_since_epoch().count()
+        + std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return engine;
+}
+
+/*
+ * 当前线程的 xorshift64* 生成器，只用于采样候选服务器
+ * 每次只有几次移位、异或和一次乘法，比 BalancerThreadEngine() 快得多，统计质量对采样足够
+ */
+inline uint64_t BalancerFastRandom()
+{
+    static thread_local uint64_t state = (std::chrono::steady_clock::now().time_since_epoch().count()
+                                          + std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;   // 状态不能为 0
+
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+/* [0, n) 上的随机数，n < 2^32；用 32 位随机数乘以 n 取高位代替取模（Lemire） */
+inline size_t BalancerFastBelow(size_t n)
+{
+    return static_cast<size_t>(((BalancerFastRandom() >> 32) * static_cast<uint64_t>(n)) >> 32);
+}
+
+/*
+ * 从 [0, n) 中不放回地随机取 d 个角标写入 out，d <= n
+ * d 很小，与已经取到的逐个比较去重即可
+ */
+inline void SampleDistinct(size_t n, size_t d, size_t* out)
+{
+    size_t count = 0;
+
+    while (count < d)
+    {
+        size_t i = BalancerFastBelow(n);
+        if (std::find(out, out + count, i) == out + count)
+            out[count++] = i;
+    }
+}
+
+/* 服务器 a 的负载是否比服务器 b 轻：比较每个核心上的未完成任务数量 */
+inline bool LessLoaded(Server& a, Server& b)
+{
+    // outstanding_a / cores_a < outstanding_b / cores_b，交叉相乘避免除法
+    return a.GetOutstandingTaskCount() * static_cast<long>(b.GetCpuCoreCount())
+           < b.GetOutstandingTaskCount() * static_cast<long>(a.GetCpuCoreCount());
+}
+
+/*
+ * random：均匀随机
+ */
+class RandomPolicy
+{
+public:
+    explicit RandomPolicy(const std::vector<ServerPtr>& servers) : servers_(servers) {}
+
+    size_t Select(uint64_t)
+    {
+        std::uniform_int_distribution<size_t> u(0, servers_.size() - 1);     // 注意-1，生成的随机数区间为[min, max]闭区间
+        return u(BalancerThreadEngine());
+    }
+
+private:
+    const std::vector<ServerPtr>&   servers_;
+};
+
+/*
+ * round：轮询
+ */
+class RoundRobinPolicy
+{
+public:
+    explicit RoundRobinPolicy(const std::vector<ServerPtr>& servers) : servers_(servers) {}
+
+    size_t Select(uint64_t)
+    {
+        return cursor_.fetch_add(1, std::memory_order_relaxed) % servers_.size();
+    }
+
+private:
+    const std::vector<ServerPtr>&   servers_;
+    alignas(64) std::atomic<size_t> cursor_{0};     // 被所有客户端线程频繁修改，独占一个缓存行
+};
+
+/*
+ * power：Power of k choices，k 为 g_config.PowerChoices
+ * 不放回地随机取 k 个不同的服务器，得分为阻塞率、每个核心上的未完成请求数量、CPU 负载的加权和（权重见 GlobalConfig），选得分最低的；
+ * 候选的指标先按列收集到连续的小数组里，再一次遍历算出所有得分，这次遍历可以被编译器向量化；
+ * 阻塞率和 CPU 负载来自服务器状态快照表，未完成请求数量读实时计数，否则所有客户端会按同一份滞后的队列长度涌向同样的服务器
+ * 快照表还没有初始化时（例如基准测试中）读取服务器
+ */
+class PowerPolicy
+{
+public:
+    explicit PowerPolicy(const std::vector<ServerPtr>& servers) : servers_(servers) {}
+
+    size_t Select(uint64_t)
+    {
+        size_t n = servers_.size();
+        size_t k = std::min<size_t>(std::max(g_config.PowerChoices, 1u), Config::kMaxJsqChoices);
+        k = std::min(k, n);
+
+        // 候选的顺序是随机的，得分相同时取第一个也就是随机取一个
+        size_t chosen[Config::kMaxJsqChoices] = {};
+        SampleDistinct(n, k, chosen);
+
+        double block[Config::kMaxJsqChoices];
+        double queue[Config::kMaxJsqChoices];
+        double load[Config::kMaxJsqChoices];
+        Gather_(chosen, k, block, queue, load);
+
+        double score[Config::kMaxJsqChoices];
+        double wb = g_config.PowerBlockWeight;
+        double wq = g_config.PowerQueueWeight;
+        double wl = g_config.PowerLoadWeight;
+        for (size_t i = 0; i < k; ++ i)
+            score[i] = wb * block[i] + wq * queue[i] + wl * load[i];
+
+        return chosen[std::min_element(score, score + k) - score];
+    }
+
+private:
+    /* 按列收集候选的阻塞率、每个核心上的未完成请求数量（实时）和 CPU 负载 */
+    void Gather_(const size_t* chosen, size_t k, double* block, double* queue, double* load)
+    {
+        EpochDomain::ReadGuard guard;
+        const ServerSnapshot* snapshot = ServerTable::Instance().Load();
+
+        if (snapshot != nullptr && snapshot->Size() == servers_.size())
+        {
+            for (size_t i = 0; i < k; ++ i)
+            {
+                size_t j = chosen[i];
+                block[i] = snapshot->block_rate[j];
+                queue[i] = 1.0 * servers_[j]->GetOutstandingTaskCount() / snapshot->cores[j];
+                load[i] = snapshot->load[j];
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < k; ++ i)
+        {
+            Server& s = *servers_[chosen[i]];
+            block[i] = s.GetBlockRate();
+            queue[i] = 1.0 * s.GetOutstandingTaskCount() / s.GetCpuCoreCount();
+            load[i] = s.GetLoad();
+        }
+    }
+
+    const std::vector<ServerPtr>&   servers_;
+};
+
+/*
+ * least：Least Outstanding Requests
+ * 遍历所有服务器，读取每个服务器精确的未完成任务数量，O(n)
+ */
+class LeastOutstandingPolicy
+{
+public:
+    explicit LeastOutstandingPolicy(const std::vector<ServerPtr>& servers) : servers_(servers) {}
+
+    size_t Select(uint64_t)
+    {
+        // 从随机位置开始遍历，负载相同时不同的客户端不会都挤到角标最小的服务器上
+        size_t n = servers_.size();
+        std::uniform_int_distribution<size_t> u(0, n - 1);
+        size_t start = u(BalancerThreadEngine());
+        size_t best = start;
+
+        for (size_t k = 1; k < n; ++ k)
+        {
+            size_t i = start + k < n ? start + k : start + k - n;
+            if (LessLoaded(*servers_[i], *servers_[best]))
+                best = i;
+        }
+
+        return best;
+    }
+
+private:
+    const std::vector<ServerPtr>&   servers_;
+};
+
+/*
+ * jsq：Join-Shortest-Queue(d)，d 为 g_config.JsqChoices
+ * 随机取 d 个不同的服务器，选未完成请求（按核心数折算）最少的；d 不小于服务器数量时等同于 least
+ */
+class JsqPolicy
+{
+public:
+    explicit JsqPolicy(const std::vector<ServerPtr>& servers) : servers_(servers), least_(servers) {}
+
+    size_t Select(uint64_t key)
+    {
+        size_t n = servers_.size();
+        size_t d = std::min<size_t>(std::max(g_config.JsqChoices, 1u), Config::kMaxJsqChoices);
+        if (d >= n)
+            return least_.Select(key);
+
+        size_t chosen[Config::kMaxJsqChoices];
+        SampleDistinct(n, d, chosen);
+
+        size_t best = chosen[0];
+        for (size_t i = 1; i < d; ++ i)
+            if (LessLoaded(*servers_[chosen[i]], *servers_[best]))
+                best = chosen[i];
+
+        return best;
+    }
+
+private:
+    const std::vector<ServerPtr>&   servers_;
+    LeastOutstandingPolicy          least_;
+};
+
+/*
+ * ewma：Peak-EWMA，k 为 g_config.PeakEwmaChoices
+ * 得分 = 响应时间的 Peak-EWMA ×（每个核心上的未完成任务数量 + 1），即新请求预计的响应时间，取 k 个候选中得分最低的
+ */
+class PeakEwmaPolicy
+{
+public:
+    explicit PeakEwmaPolicy(const std::vector<ServerPtr>& servers) : servers_(servers) {}
+
+    size_t Select(uint64_t)
+    {
+        size_t n = servers_.size();
+        size_t k = std::min<size_t>(std::max(g_config.PeakEwmaChoices, 1u), Config::kMaxJsqChoices);
+        k = std::min(k, n);
+
+        size_t chosen[Config::kMaxJsqChoices];
+        SampleDistinct(n, k, chosen);
+
+        // 还没有未完成任务的服务器得分就是它的 EWMA，会随空闲时间衰减，从而重新被尝试
+        size_t best = 0;
+        double best_score = 0;
+        for (size_t i = 0; i < k; ++ i)
+        {
+            Server& s = *servers_[chosen[i]];
+            double score = s.GetLatencyEwma() * (1.0 * s.GetOutstandingTaskCount() / s.GetCpuCoreCount() + 1);
+            if (i == 0 || score < best_score)
+            {
+                best = chosen[i];
+                best_score = score;
+            }
+        }
+
+        return best;
+    }
+
+private:
+    const std::vector<ServerPtr>&   servers_;
+};
+
+/*
+ * game：本文实现的负载均衡算法，按博弈得到的服务器权重选择，方式由 g_config.GameSelectorMode 决定
+ * 所有权重都为 0 时借用轮询算法
+ */
+class GamePolicy
+{
+public:
+    explicit GamePolicy(const std::vector<ServerPtr>& servers);
+
+    size_t Select(uint64_t key)
+    {
+        switch (g_config.GameSelectorMode)
+        {
+        case GameSelector::Alias:
+        {   // 别名表只读，在读临界区内使用不需要加锁
+            EpochDomain::ReadGuard guard;
+            const AliasTable* table = alias_table_.Load();
+            if (table == nullptr || table->Empty())
+                return round_robin_.Select(key);
+            return table->Pick(BalancerThreadEngine());
+        }
+
+        case GameSelector::SmoothWrr:
+        {
+            std::lock_guard<std::mutex> guard(swrr_mutex_);
+            if (swrr_.Empty())
+                return round_robin_.Select(key);
+            return swrr_.Pick();
+        }
+
+        default:
+            return SelectFromQueue_(key);
+        }
+    }
+
+    /* 立即更新 swrr_，别名表合并后稍后重建 */
+    void OnWeightChanged(size_t index, int weight);
+
+    /* 整体更新：swrr_、别名表和服务器队列都按新的权重重建，各自一次性替换 */
+    void OnWeightsChanged(const std::vector<int>& weights);
+
+private:
+    /*
+     * GameSelector::Queue：轮询`server_queue_`，用完一轮后重新生成
+     */
+    size_t SelectFromQueue_(uint64_t key)
+    {
+        EpochDomain::ReadGuard guard;
+
+        // 只有所有权重都为 0 时队列才为空；更新过程中读到的是旧的完整队列；还没有生成过队列时先安排生成
+        const std::vector<size_t>* queue = server_queue_.Load();
+        if (queue == nullptr || queue->empty())
+        {
+            if (queue == nullptr && !queue_refresh_pending_.exchange(true))
+                ScheduleQueueUpdate_();
+            return round_robin_.Select(key);
+        }
+
+        size_t size = queue->size();
+        size_t offset = cursor_.fetch_add(1, std::memory_order_relaxed) % size;
+
+        // 取走本轮最后一个服务器的线程负责安排更新，尚未执行的更新只保留一个
+        if (offset == size - 1 && !queue_refresh_pending_.exchange(true))
+            ScheduleQueueUpdate_();
+
+        return (*queue)[offset];
+    }
+
+    /* 安排一次`server_queue_`的更新：模拟模式下立即执行，否则交给全局时间轮线程 */
+    void ScheduleQueueUpdate_();
+
+    /*
+     * 按平滑加权轮询生成新的服务器队列，完成后通过 RcuPtr 整体替换，旧队列在所有读者离开后释放；
+     * 读者不会阻塞，也不会在更新过程中退回轮询算法
+     * 耗时 O(服务器数量 × 权重之和)，只在使用 GameSelector::Queue 时生成
+     */
+    void UpdateServerQueue_();
+
+    /* 按当前权重重建别名表并整体替换 */
+    void RebuildAliasTable_();
+
+    /* 当前所有服务器的权重，按角标排列 */
+    std::vector<int> CollectWeights_() const;
+
+    const std::vector<ServerPtr>&   servers_;
+    RoundRobinPolicy                round_robin_;               // 所有权重都为 0 时使用
+
+    RcuPtr<std::vector<size_t>>     server_queue_;              // 服务器队列，存储服务器的角标；生成好之后整体发布
+    std::atomic<bool>               queue_refresh_pending_;     // 已经安排了一次`server_queue_`的更新，还没有执行
+    alignas(64) std::atomic<size_t> cursor_{0};                 // `server_queue_`的游标，对队列长度取模
+
+    RcuPtr<AliasTable>              alias_table_;   // GameSelector::Alias 的别名表，权重变化后整体重建并发布
+    std::atomic<bool>               alias_dirty_;   // 权重已变化，别名表等待重建
+    SmoothWeightedHeap              swrr_;          // GameSelector::SmoothWrr 的堆，权重变化时增量更新
+    std::mutex                      swrr_mutex_;    // 保护 swrr_
+};
+
+/*
+ * chash：有界负载的一致性哈希
+ * 从 key 在环上的位置顺时针找第一个未满的服务器：每个核心上的未完成请求不超过环上平均值的 (1 + g_config.HashLoadEpsilon) 倍，
+ * 同一个键总是落在同一个服务器上（利用它的存储缓存），只有该服务器过载时才溢出到环上的下一个服务器；key 为 0 时随机选择
+ *
+ * 服务器退出或重新参与负载均衡时，只增删它的虚拟节点，其它服务器负责的键保持不变
+ */
+class ConsistentHashPolicy
+{
+public:
+    explicit ConsistentHashPolicy(const std::vector<ServerPtr>& servers);
+
+    size_t Select(uint64_t key)
+    {
+        EpochDomain::ReadGuard guard;
+
+        const RingState* state = ring_.Load();
+        if (key == 0 || state == nullptr || state->ring.Empty())
+            return random_.Select(key);
+
+        // 每个核心的负载上限 = (1 + ε) × (环上的未完成请求 + 本次请求) / 环上的核心数，
+        // 各服务器的上限之和大于总负载，顺时针查找一定能找到未满的服务器
+        long total = 0;
+        for (size_t i : state->members)
+            total += servers_[i]->GetOutstandingTaskCount();
+
+        double limit_per_core = (1 + g_config.HashLoadEpsilon) * (total + 1) / state->cores;
+
+        return state->ring.Lookup(key, [this, limit_per_core](uint32_t i) {
+            Server& s = *servers_[i];
+            return s.GetOutstandingTaskCount() < std::ceil(limit_per_core * s.GetCpuCoreCount());
+        });
+    }
+
+    void OnServerAdded(size_t index);
+    void OnServerRemoved(size_t index);
+
+private:
+    /* 哈希环及环上的服务器，整体发布；环上的节点为服务器的角标 */
+    struct RingState
+    {
+        HashRing            ring;
+        std::vector<size_t> members;    // 在环上的服务器
+        unsigned            cores;      // 环上服务器的 CPU 核心总数
+    };
+
+    /* 在 ring_mutex_ 内用 update 修改当前的哈希环，并发布修改后的新环 */
+    template<typename F>
+    void UpdateRing_(F update);
+
+    const std::vector<ServerPtr>&   servers_;
+    RandomPolicy                    random_;        // 没有键时使用
+    RcuPtr<RingState>               ring_;          // 服务器加入或移出时生成新环并整体替换
+    std::mutex                      ring_mutex_;    // 串行化哈希环的修改
+};
+
+#endif //TINYEDGEPLAYER_BALANCER_POLICIES_H
@@ -0,0 +1,192 @@
+#ifndef TINYEDGEPLAYER_BALANCER_POLICY_H
+#define TINYEDGEPLAYER_BALANCER_POLICY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Server.h"
+
+using ServerPtr = std::shared_ptr<Server>;
+
+/*
+ * 负载均衡策略
+ *
+ * 每个负载均衡算法是一个策略类，满足以下约定（不需要继承任何基类）：
+ *
+ *     class MyPolicy
+ *     {
+ *     public:
+ *         explicit MyPolicy(const std::vector<ServerPtr>& servers);   // servers 在策略的整个生命周期内有效且不变
+ *
+ *         size_t Select(uint64_t key);                 // 必需：返回选中的服务器在 servers 中的角标，会被多个客户端线程并发调用
+ *         void OnWeightChanged(size_t index, int w);   // 可选：第 index 个服务器的权重变为 w
+ *         void OnWeightsChanged(const std::vector<int>& w);     // 可选：所有服务器的权重整体更新，没有实现时逐个调用 OnWeightChanged()
+ *         void OnServerAdded(size_t index);            // 可选：第 index 个服务器重新参与负载均衡
+ *         void OnServerRemoved(size_t index);          // 可选：第 index 个服务器退出负载均衡
+ *     };
+ *
+ * BalancerCore<Policy> 把策略包装成 BalancerSelector：Select() 在编译期绑定到策略的实现并被完全内联，
+ * 只有 Balancer 调用当前策略时有一次虚函数调用；可选的回调在编译期检测，策略没有实现时什么都不做
+ *
+ * 策略通过 REGISTER_BALANCER_POLICY(Policy, "name") 注册到 BalancerRegistry，之后即可用 --balancer=name 选择；
+ * 第三方策略只需要在自己的源文件中定义策略类并注册，不需要修改 balancer.cpp 和 main.cpp
+ */
+
+/*
+ * 策略实例的类型擦除接口，由 BalancerCore<Policy> 实现
+ */
+class BalancerSelector
+{
+public:
+    virtual ~BalancerSelector() = default;
+
+    virtual size_t Select(uint64_t key) = 0;
+
+    virtual void OnWeightChanged(size_t index, int weight) = 0;
+    virtual void OnWeightsChanged(const std::vector<int>& weights) = 0;
+    virtual void OnServerAdded(size_t index) = 0;
+    virtual void OnServerRemoved(size_t index) = 0;
+};
+
+namespace balancer_detail
+{
+    template<typename P, typename = void>
+    struct HasWeightHook : std::false_type {};
+
+    template<typename P>
+    struct HasWeightHook<P, std::void_t<decltype(std::declval<P&>().OnWeightChanged(size_t(), int()))>>
+        : std::true_type {};
+
+    template<typename P, typename = void>
+    struct HasWeightsHook : std::false_type {};
+
+    template<typename P>
+    struct HasWeightsHook<P, std::void_t<decltype(std::declval<P&>().OnWeightsChanged(std::declval<const std::vector<int>&>()))>>
+        : std::true_type {};
+
+    template<typename P, typename = void>
+    struct HasMembershipHooks : std::false_type {};
+
+    template<typename P>
+    struct HasMembershipHooks<P, std::void_t<decltype(std::declval<P&>().OnServerAdded(size_t())),
+                                             decltype(std::declval<P&>().OnServerRemoved(size_t()))>>
+        : std::true_type {};
+}
+
+/*
+ * 负载均衡的模板核心：持有一个策略实例，把调用静态地转发给它
+ * 也可以脱离 Balancer 直接使用（例如在已知策略的基准测试中），此时整个选择过程没有任何间接调用
+ */
+template<typename Policy>
+class BalancerCore final : public BalancerSelector
+{
+public:
+    explicit BalancerCore(const std::vector<ServerPtr>& servers) : policy_(servers) {}
+
+    size_t Select(uint64_t key) override { return policy_.Select(key); }
+
+    void OnWeightChanged(size_t index, int weight) override
+    {
+        if constexpr (balancer_detail::HasWeightHook<Policy>::value)
+            policy_.OnWeightChanged(index, weight);
+    }
+
+    void OnWeightsChanged(const std::vector<int>& weights) override
+    {
+        if constexpr (balancer_detail::HasWeightsHook<Policy>::value)
+            policy_.OnWeightsChanged(weights);
+        else if constexpr (balancer_detail::HasWeightHook<Policy>::value)
+            for (size_t i = 0; i < weights.size(); ++ i)
+                policy_.OnWeightChanged(i, weights[i]);
+    }
+
+    void OnServerAdded(size_t index) override
+    {
+        if constexpr (balancer_detail::HasMembershipHooks<Policy>::value)
+            policy_.OnServerAdded(index);
+    }
+
+    void OnServerRemoved(size_t index) override
+    {
+        if constexpr (balancer_detail::HasMembershipHooks<Policy>::value)
+            policy_.OnServerRemoved(index);
+    }
+
+    Policy& GetPolicy() { return policy_; }
+
+private:
+    Policy  policy_;
+};
+
+/*
+ * 策略注册表：名字 -> 创建策略实例的工厂
+ * 注册通常发生在静态初始化阶段（REGISTER_BALANCER_POLICY），查询发生在 main() 之后
+ */
+class BalancerRegistry
+{
+public:
+    using Factory = std::function<std::unique_ptr<BalancerSelector> (const std::vector<ServerPtr>&)>;
+
+    static BalancerRegistry& Instance()
+    {
+        static BalancerRegistry r;
+        return r;
+    }
+
+    /* 注册一个策略，名字已被占用时返回 false（先注册的保留） */
+    bool Register(const std::string& name, Factory factory)
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        return factories_.emplace(name, std::move(factory)).second;
+    }
+
+    /* 创建名为 name 的策略实例，名字未注册时返回 nullptr */
+    std::unique_ptr<BalancerSelector> Create(const std::string& name, const std::vector<ServerPtr>& servers) const
+    {
+        Factory factory;
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            auto it = factories_.find(name);
+            if (it == factories_.end())
+                return nullptr;
+            factory = it->second;
+        }
+        return factory(servers);
+    }
+
+    /* get 所有已注册的名字，按字典序排列 */
+    std::vector<std::string> GetNames() const
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        std::vector<std::string> names;
+        for (const auto& kv : factories_)
+            names.push_back(kv.first);
+        return names;
+    }
+
+private:
+    BalancerRegistry() = default;
+
+    mutable std::mutex              mutex_;
+    std::map<std::string, Factory>  factories_;
+};
+
+#define BALANCER_POLICY_CONCAT_INNER_(a, b) a##b
+#define BALANCER_POLICY_CONCAT_(a, b) BALANCER_POLICY_CONCAT_INNER_(a, b)
+
+/* 在命名空间作用域中使用，把策略类 Policy 注册为 name */
+#define REGISTER_BALANCER_POLICY(Policy, name)                                                              \
+    static const bool BALANCER_POLICY_CONCAT_(kBalancerPolicyRegistered_, __LINE__) =                       \
+        BalancerRegistry::Instance().Register(name, [](const std::vector<ServerPtr>& servers) {             \
+            return std::unique_ptr<BalancerSelector>(new BalancerCore<Policy>(servers));                    \
+        })
+
+#endif //TINYEDGEPLAYER_BALANCER_POLICY_H
@@ -0,0 +1,141 @@
+/*
+ * 统计每提交一个任务所产生的堆分配次数
+ * legacy     : 重构前 ExecuteTask() 的做法（shared_ptr<promise> + std::bind + std::function + 两个 std::deque）
+ * ExecuteTask: 当前的 ExecuteTask()，闭包放在任务槽内（约 48 字节，不超过 TaskSlot::kStorageSize），
+ *              只剩 std::promise 需要分配：libstdc++ 分别分配共享状态和结果对象，每个任务 2 次
+ * Submit     : 任务槽 + TaskHandle，全程不分配
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <future>
+#include <new>
+#include <vector>
+
+#include "threadpool.h"
+
+static std::atomic<uint64_t> g_alloc_count(0);
+
+void* operator new(std::size_t size)
+{
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+static const int kRounds = 200;
+static const int kBatch = 512;      // 每轮提交的任务数，小于任务槽数量，保证 Submit() 不会因为槽耗尽而失败
+
+struct Result
+{
+    double allocs_per_task;
+    double ns_per_task;
+};
+
+template<typename Fn>
+static Result Measure(Fn&& run_round)
+{
+    run_round();    // 预热
+
+    uint64_t before = g_alloc_count.load();
+    auto start = std::chrono::steady_clock::now();
+
+    for (int r = 0; r < kRounds; ++ r)
+        run_round();
+
+    auto end = std::chrono::steady_clock::now();
+    uint64_t after = g_alloc_count.load();
+
+    double tasks = 1.0 * kRounds * kBatch;
+    return Result{(after - before) / tasks,
+                  std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / tasks};
+}
+
+int main()
+{
+    std::atomic<uint64_t> sum(0);
+    int value = 1;
+
+    /* 1. legacy：按重构前的方式构造任务并入队，然后在当前线程执行 */
+    std::deque<std::function<void ()>> legacy_tasks;
+    std::deque<std::chrono::system_clock::time_point> legacy_enter_time;
+    std::vector<std::future<void>> legacy_futures;
+    legacy_futures.reserve(kBatch);
+
+    Result legacy = Measure([&]() {
+        for (int i = 0; i < kBatch; ++ i)
+        {
+            auto promise = std::make_shared<std::promise<void>>();
+            legacy_futures.emplace_back(promise->get_future());
+
+            auto func = std::bind([&sum](int v) { sum += v; }, value);
+            legacy_tasks.emplace_back([t = std::move(func), pm = promise]() mutable {
+                t();
+                pm->set_value();
+            });
+            legacy_enter_time.emplace_back(std::chrono::system_clock::now());
+        }
+
+        while (!legacy_tasks.empty())
+        {
+            legacy_tasks.front()();
+            legacy_tasks.pop_front();
+            legacy_enter_time.pop_front();
+        }
+
+        legacy_futures.clear();
+    });
+
+    ThreadPool pool(2);
+
+    /* 2. ExecuteTask */
+    std::vector<std::future<void>> futures;
+    futures.reserve(kBatch);
+
+    Result execute = Measure([&]() {
+        for (int i = 0; i < kBatch; ++ i)
+            futures.emplace_back(pool.ExecuteTask([&sum, value]() { sum += value; }));
+
+        for (auto& f : futures)
+            f.wait();
+        futures.clear();
+    });
+
+    /* 3. Submit */
+    std::vector<TaskHandle> handles;
+    handles.reserve(kBatch);
+
+    Result submit = Measure([&]() {
+        for (int i = 0; i < kBatch; ++ i)
+            handles.emplace_back(pool.Submit([&sum, value]() { sum += value; }));
+
+        for (auto& h : handles)
+            h.Wait();
+        handles.clear();
+    });
+
+    pool.JoinAll();
+
+    std::printf("%-12s %16s %12s\n", "path", "allocs/task", "ns/task");
+    std::printf("%-12s %16.3f %12.1f\n", "legacy", legacy.allocs_per_task, legacy.ns_per_task);
+    std::printf("%-12s %16.3f %12.1f\n", "ExecuteTask", execute.allocs_per_task, execute.ns_per_task);
+    std::printf("%-12s %16.3f %12.1f\n", "Submit", submit.allocs_per_task, submit.ns_per_task);
+    std::printf("(checksum %lu)\n", static_cast<unsigned long>(sum.load()));
+
+    return 0;
+}
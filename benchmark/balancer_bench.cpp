@@ -0,0 +1,118 @@
+/*
+ * 负载均衡器选择服务器的吞吐量随客户端线程数量的变化
+ * 每个客户端线程连续调用 Balancer::SelectOneServer()，统计所有线程合计的每秒选择次数
+ * 服务器使用共享执行器后端，不为每个服务器创建线程，测量时没有请求在执行
+ * power 按不同的候选数量 k 各测一次，用于按服务器数量选择 k
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "balancer.h"
+#include "config.h"
+#include "server_table.h"
+
+static const int kServerCount = 100;
+static const int kSelectionsPerThread = 1 << 20;
+
+/* 用 threads 个线程各选择 kSelectionsPerThread 次，返回每秒的选择次数 */
+static double Measure(unsigned threads)
+{
+    std::atomic<unsigned> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<uintptr_t> sink(0);
+    std::vector<std::thread> clients;
+
+    for (unsigned t = 0; t < threads; ++ t)
+    {
+        clients.emplace_back([&]() {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire))
+                ;
+
+            uintptr_t local = 0;
+            for (int i = 0; i < kSelectionsPerThread; ++ i)
+                local += reinterpret_cast<uintptr_t>(Balancer::Instance().SelectOneServer().get());
+            sink.fetch_add(local, std::memory_order_relaxed);
+        });
+    }
+
+    while (ready.load() < threads)
+        ;
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+
+    for (auto& c : clients)
+        c.join();
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+
+    return 1.0 * threads * kSelectionsPerThread / seconds;
+}
+
+int main()
+{
+    g_config.SharedExecutor = true;     // 不为每个服务器创建线程
+    g_config.GcInterval = 3600 * 1000;  // 测量期间不做 GC
+
+    std::vector<std::shared_ptr<Server>> servers;
+    for (int i = 0; i < kServerCount; ++ i)
+        servers.emplace_back(CreateOneServer(i));
+
+    ServerTable::Instance().Init(servers);
+    Balancer::Instance().Init(servers);
+
+    struct Algorithm
+    {
+        const char*     name;
+        const char*     policy;     // 在 BalancerRegistry 中注册的策略名
+        GameSelector    selector;   // 只对 game 有效
+        unsigned        choices;    // 只对 power 有效，候选数量 k
+    };
+
+    const Algorithm algorithms[] = {
+        {"random", "random", GameSelector::Alias, 2},
+        {"round", "round", GameSelector::Alias, 2},
+        {"game-queue", "game", GameSelector::Queue, 2},
+        {"game-alias", "game", GameSelector::Alias, 2},
+        {"game-swrr", "game", GameSelector::SmoothWrr, 2},
+        {"power", "power", GameSelector::Alias, 2},
+        {"power-k4", "power", GameSelector::Alias, 4},
+        {"power-k8", "power", GameSelector::Alias, 8},
+        {"least", "least", GameSelector::Alias, 2},
+        {"jsq", "jsq", GameSelector::Alias, 2},
+        {"ewma", "ewma", GameSelector::Alias, 2},
+    };
+
+    unsigned max_threads = std::max(2u, std::thread::hardware_concurrency()) * 2;
+
+    std::printf("%-12s %8s %16s %10s\n", "balancer", "threads", "selections/s", "speedup");
+    for (const auto& a : algorithms)
+    {
+        g_config.GameSelectorMode = a.selector;
+        g_config.PowerChoices = a.choices;
+        Balancer::Instance().SetPolicy(a.policy);
+
+        double base = 0;
+        for (unsigned threads = 1; threads <= max_threads; threads *= 2)
+        {
+            double rate = Measure(threads);
+            if (threads == 1)
+                base = rate;
+            std::printf("%-12s %8u %16.0f %10.2f\n", a.name, threads, rate, rate / base);
+        }
+    }
+
+    ServerTable::Instance().Stop();
+    for (auto& s : servers)
+        s->Stop();
+
+    return 0;
+}
@@ -2,6 +2,81 @@
 #define EDGEPLAYER_CONFIG_H
 
 #include <string>
+#include <cstdint>
+
+#include "rate_limiter/clock.h"
+
+/*
+ * 线程池任务队列的组织方式
+ * Shared       : 所有 worker 共享一个加锁的任务队列（默认）
+ * WorkStealing : 每个 worker 一个 Chase-Lev 双端队列，空闲的 worker 随机窃取其它 worker 的任务
+ * BoundedRing  : 有界无锁环形队列，队满时拒绝新任务或让提交方等待（背压）
+ * Priority     : 按优先级分类的加锁队列，总是先执行优先级高的任务，同一优先级内 FIFO
+ * Deadline     : 加锁的最早截止期限优先（EDF）队列，System 优先级的任务总是最先执行
+ */
+enum class QueueMode
+{
+    Shared,
+    WorkStealing,
+    BoundedRing,
+    Priority,
+    Deadline,
+};
+
+/*
+ * 任务优先级，数值越小优先级越高
+ * System 用于服务器自身的管理任务（例如GC），不会因为超过截止期限而被丢弃
+ */
+enum class TaskPriority : uint8_t
+{
+    System = 0,
+    High,
+    Normal,
+    Low,
+};
+
+const int kTaskPriorityCount = 4;
+
+/*
+ * 线程池的执行方式
+ * Threads   : 每个 CPU 核心对应一个真实的 worker 线程，任务耗时通过 sleep_for 模拟（默认）
+ * Simulated : 不创建线程，任务在离散事件模拟器（见 simulator.h）的虚拟时钟上排队和执行
+ * Executor  : 不创建线程，CPU 核心只是逻辑容量，任务投递到进程级共享执行器（见 executor.h）上执行
+ */
+enum class PoolBackend
+{
+    Threads,
+    Simulated,
+    Executor,
+};
+
+/*
+ * Game 负载均衡算法按服务器权重选择服务器的方式
+ * Queue     : 每轮按平滑加权轮询生成一个长度等于权重之和的服务器队列，生成代价 O(权重之和 × 服务器数量)
+ * Alias     : 按权重随机选择（Vose 别名表），选择 O(1) 且不加锁（别名表通过 RCU 发布），权重变化时 O(n) 重建（默认）
+ * SmoothWrr : 用堆实现的平滑加权轮询，选择和单个权重变化都是 O(log n)，但每次选择都要锁住同一个堆
+ */
+enum class GameSelector
+{
+    Queue,
+    Alias,
+    SmoothWrr,
+};
+
+/*
+ * 分层限流的层，一次请求从叶子到根依次通过每一层
+ * Client : 单个客户端在单个服务器上的限流器（GlobalConfig::ClientRateLimit）
+ * Server : 服务器的限流器（Config::kDefaultRateLimit，由监测器调整）
+ * Global : 所有服务器共用的全局限流器（GlobalConfig::GlobalRateLimit）
+ */
+enum class RateLevel
+{
+    Client,
+    Server,
+    Global,
+};
+
+const int kRateLevelCount = 3;
 
 struct GlobalConfig
 {
@@ -10,11 +85,62 @@ struct GlobalConfig
         Verbose = false;
         GameMode = true;
         GcInterval = 1000;
+        PoolQueueMode = QueueMode::Shared;
+        QueueCapacity = 256;
+        TaskDeadline = 100;
+        DropExpiredTasks = false;
+        Simulate = false;
+        SharedExecutor = false;
+        GameSelectorMode = GameSelector::Alias;
+        JsqChoices = 2;
+        PeakEwmaTau = 1000;
+        PeakEwmaChoices = 2;
+        HashLoadEpsilon = 0.25;
+        SnapshotPeriod = 100;
+        PowerChoices = 2;
+        PowerBlockWeight = 1;
+        PowerQueueWeight = 0;
+        PowerLoadWeight = 0;
+        RateBurst = 1;
+        RateByCost = false;
+        Clock = ClockSource::Monotonic;
+        GlobalRateLimit = 0;
+        ClientRateLimit = 0;
+    }
+
+    /* 各个 Server 的线程池使用的执行方式 */
+    PoolBackend Backend() const
+    {
+        if (Simulate)
+            return PoolBackend::Simulated;
+        return SharedExecutor ? PoolBackend::Executor : PoolBackend::Threads;
     }
 
     bool Verbose;
     bool GameMode;
     int GcInterval;
+    QueueMode PoolQueueMode;    // 各个 Server 的线程池使用的任务队列模式
+    unsigned QueueCapacity;     // BoundedRing 模式下任务队列的容量
+    unsigned TaskDeadline;      // 任务的默认截止期限（相对入队时间），单位 ms
+    bool DropExpiredTasks;      // 是否在执行前丢弃已经超过截止期限的任务
+    bool Simulate;              // 是否运行在离散事件模拟模式下（所有 Server 的线程池使用 PoolBackend::Simulated）
+    bool SharedExecutor;        // 所有 Server 的线程池是否共用进程级的执行器（PoolBackend::Executor）
+    GameSelector GameSelectorMode;  // Game 负载均衡算法按权重选择服务器的方式
+    unsigned JsqChoices;        // JSQ(d) 负载均衡算法每次比较的服务器数量 d
+    unsigned PeakEwmaTau;       // 响应时间 Peak-EWMA 的衰减时间常数，单位 ms
+    unsigned PeakEwmaChoices;   // PeakEwma 负载均衡算法每次比较的服务器数量 k
+    double HashLoadEpsilon;     // ConsistentHash 负载均衡算法的负载上限：每个服务器不超过平均负载的 (1 + ε) 倍
+    unsigned SnapshotPeriod;    // 服务器状态快照表的采集周期，单位 ms
+    unsigned PowerChoices;      // Power 负载均衡算法每次比较的服务器数量 k
+    /* Power 负载均衡算法的得分 = 阻塞率 × PowerBlockWeight + 每个核心上的未完成请求数量 × PowerQueueWeight + CPU 负载 × PowerLoadWeight */
+    double PowerBlockWeight;
+    double PowerQueueWeight;
+    double PowerLoadWeight;
+    unsigned RateBurst;         // 每台服务器限流器的突发大小（令牌数）
+    bool RateByCost;            // 是否按任务的计算开销收取令牌（每 Config::kRateTokenTime ms 一个），而不是每个请求一个
+    ClockSource Clock;          // 限流器和线程池时间戳使用的时间源
+    unsigned GlobalRateLimit;   // 所有服务器合计的限流值，0 表示不限制
+    unsigned ClientRateLimit;   // 单个客户端在单个服务器上的限流值，0 表示不限制
 };
 
 extern GlobalConfig g_config;
@@ -35,6 +161,15 @@ namespace Config
     // proxy 节点获取服务器权重的周期，单位 s
     const unsigned kProxyUpdateServerWeightTime = kGameTerm;
 
+    // 博弈求解得到的最大权重，其它服务器的权重按均衡流量的比例换算
+    const int kGameMaxWeight = 100;
+
+    // 博弈求解时总请求速率相对总算力的上限，超过时视为过载
+    const double kGameMaxUtilization = 0.95;
+
+    // RAM 占满时服务器保留的算力比例
+    const double kGameMinRamFactor = 0.05;
+
     // 做一次本地资源管理的时间，ms
     const unsigned kGcTime = 100;
     // 一次本地资源管理的释放空间大小，MB
@@ -46,9 +181,40 @@ namespace Config
     // 限流针对的是每台服务器
     const unsigned kDefaultRateLimit = 50;
 
+    // 按任务的计算开销收取令牌时，一个令牌对应的计算开销，单位 ms；最短的任务收取一个令牌
+    // 此时限流参数的单位为每秒的令牌数
+    const unsigned kRateTokenTime = kMinRequestTime;
+
+    // 每个线程池预分配的任务槽数量，即不需要堆分配就能同时排队/执行的任务数量
+    const unsigned kTaskSlotCount = 1024;
+
+    // 线程池统计数据的滑动窗口长度，单位为监测周期（1s）
+    const unsigned kStatsWindowSize = 3;
+
+    // BoundedRing 模式下任务队列的默认容量
+    const unsigned kDefaultQueueCapacity = 256;
+
     // 客户端发送请求的时间时隔，单位 ms
     const unsigned kRequestInterval = 20;
 
+    // 负载均衡器请求计数的分片数量，每个客户端线程固定写一个分片，超过分片数量的线程共享分片
+    const unsigned kBalancerCounterShards = 32;
+
+    // JSQ(d)、PeakEwma 和 Power 负载均衡算法每次比较的服务器数量的上限
+    const unsigned kMaxJsqChoices = 16;
+
+    // 每个服务器上单独限流的客户端数量，客户端编号超过时按取模共用限流器
+    const unsigned kMaxClientBudgets = 64;
+
+    // 一致性哈希环上每个 CPU 核心对应的虚拟节点数量，核心多的服务器分到的键也多
+    const unsigned kHashRingVirtualNodesPerCore = 32;
+
+    // 客户端请求的内容键的数量
+    const unsigned kContentKeyCount = 1000;
+
+    // 每个服务器的存储缓存的内容数量
+    const unsigned kContentCacheEntries = 64;
+
     // 存放实验数据的目录
     const std::string data_file_path = "/home/patric/data/";
 }
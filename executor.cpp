@@ -0,0 +1,88 @@
+#include "executor.h"
+#include "timer_wheel.h"
+
+/* 当前线程是否是执行器的 worker */
+static thread_local bool tls_in_executor = false;
+
+Executor::Executor(unsigned thread_count)
+    : shutdown_(false)
+{
+    if (thread_count == 0)
+        thread_count = 1;
+
+    for (unsigned i = 0; i < thread_count; ++ i)
+        workers_.emplace_back([this]() { WorkerRoutine_(); });
+}
+
+Executor::~Executor()
+{
+    Shutdown();
+}
+
+Executor& Executor::Instance()
+{
+    static Executor e(std::thread::hardware_concurrency());
+    return e;
+}
+
+bool Executor::InWorkerThread()
+{
+    return tls_in_executor;
+}
+
+void Executor::Post(Callback task)
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        tasks_.emplace_back(std::move(task));
+    }
+    cond_.notify_one();
+}
+
+void Executor::ScheduleAfter(std::chrono::nanoseconds delay, Callback cb)
+{
+    // 计时交给全局时间轮，到期后回调投递给 worker，不在时间轮线程中执行
+    TimerWheel::Instance().Schedule(delay, [this, cb = std::move(cb)]() mutable { Post(std::move(cb)); });
+}
+
+void Executor::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        if (shutdown_)
+            return;
+        shutdown_ = true;
+    }
+
+    cond_.notify_all();
+
+    for (auto& t : workers_)
+    {
+        if (t.joinable())
+            t.join();
+    }
+}
+
+void Executor::WorkerRoutine_()
+{
+    tls_in_executor = true;
+
+    while (true)
+    {
+        Callback task;
+
+        {
+            std::unique_lock<std::mutex> guard(mutex_);
+            cond_.wait(guard, [this]() { return shutdown_ || !tasks_.empty(); });
+
+            if (shutdown_ && tasks_.empty())
+                return;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+    }
+}
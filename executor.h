@@ -0,0 +1,61 @@
+#ifndef TINYEDGEPLAYER_EXECUTOR_H
+#define TINYEDGEPLAYER_EXECUTOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * 进程级共享执行器
+ * 线程数量等于 std::thread::hardware_concurrency()，所有使用 PoolBackend::Executor 的线程池都把任务投递到这里，
+ * 它们的“CPU 核心”只是逻辑上的容量，不再各自占用线程
+ *
+ * 定时回调由全局时间轮计时，到期后投递给 worker 执行；线程池用它来模拟任务占用核心的时间
+ *
+ * 投递的任务和回调都不能阻塞，否则会占住一个真实的线程
+ */
+class Executor
+{
+public:
+    using Callback = std::function<void ()>;
+
+    static Executor& Instance();    // 单例模式，第一次调用时启动线程
+
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    void operator=(const Executor&) = delete;
+
+    /* 投递一个任务，由任意一个 worker 执行 */
+    void    Post(Callback task);
+
+    /* 在 delay 之后执行 cb */
+    void    ScheduleAfter(std::chrono::nanoseconds delay, Callback cb);
+
+    /* 停止所有 worker：已投递的任务会执行完；之后到期的定时回调不会再被执行 */
+    void    Shutdown();
+
+    /* get worker 线程数量 */
+    unsigned GetThreadCount() const { return static_cast<unsigned>(workers_.size()); }
+
+    /* 当前线程是否是执行器的 worker（在 worker 中不能做任何阻塞等待） */
+    static bool InWorkerThread();
+
+private:
+    explicit Executor(unsigned thread_count);
+
+    void    WorkerRoutine_();
+
+    std::mutex                  mutex_;
+    std::condition_variable     cond_;
+    std::deque<Callback>        tasks_;
+    bool                        shutdown_;
+
+    std::vector<std::thread>    workers_;
+};
+
+#endif //TINYEDGEPLAYER_EXECUTOR_H
@@ -0,0 +1,211 @@
+#include "game_solver.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glog/logging.h>
+
+#include "balancer.h"
+#include "config.h"
+#include "server_table.h"
+#include "simulator.h"
+#include "timer_wheel.h"
+
+namespace wardrop
+{
+    /* 水位为 t 时的总流量；四路累加，浮点加法不需要重排就能向量化 */
+    static double TotalFlow(const double* capacity, const double* penalty, size_t n, double t)
+    {
+        double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        size_t i = 0;
+
+        for (; i + 4 <= n; i += 4)
+        {
+            s0 += std::max(0.0, capacity[i] - penalty[i] * t);
+            s1 += std::max(0.0, capacity[i + 1] - penalty[i + 1] * t);
+            s2 += std::max(0.0, capacity[i + 2] - penalty[i + 2] * t);
+            s3 += std::max(0.0, capacity[i + 3] - penalty[i + 3] * t);
+        }
+        for (; i < n; ++ i)
+            s0 += std::max(0.0, capacity[i] - penalty[i] * t);
+
+        return (s0 + s1) + (s2 + s3);
+    }
+
+    double SolveLevel(const double* capacity, const double* penalty, size_t n, double demand)
+    {
+        // t = 0 时总流量为 sum(capacity) > demand；t = max(capacity / penalty) 时总流量为 0
+        double lo = 0, hi = 0;
+        for (size_t i = 0; i < n; ++ i)
+            hi = std::max(hi, capacity[i] / penalty[i]);
+
+        // 总流量随 t 单调递减，每次二分都是一次对数组的遍历，最多 64 次
+        for (int iter = 0; iter < 64 && hi - lo > 1e-9 * hi; ++ iter)
+        {
+            double mid = (lo + hi) / 2;
+            if (TotalFlow(capacity, penalty, n, mid) > demand)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        // 活跃集合（有流量的服务器）已经确定，在它上面 sum(capacity - penalty * t) = demand 是线性方程，直接解出
+        double t = (lo + hi) / 2;
+        double sum_capacity = 0, sum_penalty = 0;
+        for (size_t i = 0; i < n; ++ i)
+        {
+            bool active = capacity[i] > penalty[i] * t;
+            sum_capacity += active ? capacity[i] : 0;
+            sum_penalty += active ? penalty[i] : 0;
+        }
+
+        if (sum_penalty > 0)
+        {
+            double exact = (sum_capacity - demand) / sum_penalty;
+            if (exact >= 0)
+                t = exact;
+        }
+
+        return t;
+    }
+
+    void Flows(const double* capacity, const double* penalty, size_t n, double t, double* flow)
+    {
+        for (size_t i = 0; i < n; ++ i)
+            flow[i] = std::max(0.0, capacity[i] - penalty[i] * t);
+    }
+}
+
+GameSolver::GameSolver()
+    : shutdown_(false), level_(0), demand_(0)
+{}
+
+GameSolver& GameSolver::Instance()
+{
+    static GameSolver s;
+    return s;
+}
+
+void GameSolver::Init(const std::vector<std::shared_ptr<Server>>& server_pool)
+{
+    servers_ = server_pool;
+
+    size_t n = servers_.size();
+    capacity_.resize(n);
+    penalty_.resize(n);
+    flow_.resize(n);
+    weights_.resize(n);
+
+    std::chrono::seconds term(Config::kProxyUpdateServerWeightTime);
+
+    if (g_config.Simulate)
+    {
+        Simulator::Instance().Every(term, [this]() {
+            if (shutdown_)
+                return false;
+            SolveOnce();
+            return true;
+        });
+        return;
+    }
+
+    // 求解注册在全局时间轮上，不占用请求路径，也不再为每个服务器创建博弈线程
+    timer_ = TimerWheel::Instance().Every(term, [this]() {
+        if (!shutdown_)
+            SolveOnce();
+    });
+}
+
+void GameSolver::Stop()
+{
+    timer_.Cancel();
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    shutdown_ = true;
+}
+
+void GameSolver::SolveOnce()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    size_t n = servers_.size();
+    if (n == 0)
+        return;
+
+    /* 1. 收集服务器状态：按列读取服务器状态快照表，快照表还没有初始化时（例如基准测试中）读取服务器 */
+    double demand = 0;
+    double sum_capacity = 0;
+
+    {
+        EpochDomain::ReadGuard read_guard;
+        const ServerSnapshot* snapshot = ServerTable::Instance().Load();
+        bool use_snapshot = snapshot != nullptr && snapshot->Size() == n;
+
+        for (size_t i = 0; i < n; ++ i)
+        {
+            double task_ms, ram_load, block_rate, speed;
+            unsigned cores;
+
+            if (use_snapshot)
+            {
+                task_ms = snapshot->avg_task_time[i];
+                ram_load = snapshot->ram_load[i];
+                block_rate = snapshot->block_rate[i];
+                speed = snapshot->speed[i];
+                cores = snapshot->cores[i];
+            }
+            else
+            {
+                Server& s = *servers_[i];
+                task_ms = s.GetAvgTaskTime();
+                ram_load = s.GetRamLoad();
+                block_rate = s.GetBlockRate();
+                speed = s.GetCurrentSpeed();
+                cores = s.GetCpuCoreCount();
+            }
+
+            // 算力：每个核心每秒能处理 1000 / 平均任务耗时 个请求；RAM 越满可用的算力越少
+            double ram_factor = std::max(1.0 - ram_load, Config::kGameMinRamFactor);
+            capacity_[i] = cores * 1000.0 / std::max(task_ms, 1.0) * ram_factor;
+            penalty_[i] = 1.0 + block_rate;
+
+            demand += speed;
+            sum_capacity += capacity_[i];
+        }
+    }
+
+    if (sum_capacity <= 0)
+        return;
+
+    // 过载时均衡不存在（总请求速率超过总算力），按接近满载求解，流量比例趋于与算力成正比
+    demand = std::min(demand, Config::kGameMaxUtilization * sum_capacity);
+
+    /* 2. 求均衡 */
+    double t = wardrop::SolveLevel(capacity_.data(), penalty_.data(), n, demand);
+    wardrop::Flows(capacity_.data(), penalty_.data(), n, t, flow_.data());
+
+    /* 3. 换算为整数权重：流量最大的服务器为 Config::kGameMaxWeight，有流量的服务器至少为 1 */
+    double max_flow = *std::max_element(flow_.begin(), flow_.end());
+    if (max_flow <= 0)
+        return;
+
+    for (size_t i = 0; i < n; ++ i)
+    {
+        int w = static_cast<int>(std::lround(flow_[i] / max_flow * Config::kGameMaxWeight));
+        weights_[i] = flow_[i] > 0 ? std::max(w, 1) : 0;
+    }
+
+    level_ = t;
+    demand_ = demand;
+
+    /* 4. 整体发布 */
+    Balancer::Instance().SetWeights(weights_);
+
+    if (g_config.Verbose)
+    {
+        std::string log_string = "game: demand=" + std::to_string(demand) + " level=" + std::to_string(t) + " weights=";
+        for (size_t i = 0; i < n && i < 16; ++ i)
+            log_string += std::to_string(weights_[i]) + " ";
+        LOG(INFO) << log_string;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef TINYEDGEPLAYER_GAME_SOLVER_H
+#define TINYEDGEPLAYER_GAME_SOLVER_H
+
+/*
+ * 博弈求解器
+ * 每个博弈周期（Config::kGameTerm）根据所有服务器的状态求出请求在服务器之间的 Wardrop 均衡，
+ * 把均衡时的流量比例换算为整数权重，一次性发布给负载均衡器（Game 算法按权重选择服务器）
+ *
+ * 模型：把每个请求看作一个自私的参与者，在服务器 i 上的代价（预计响应时间）为 M/M/1 形式的
+ *     c_i(x_i) = a_i / (mu_i - x_i)
+ * 其中 x_i 为分到服务器 i 的请求速率，mu_i 为有效处理能力（核心数 / 平均任务耗时，再按 RAM 占用率折减），
+ * a_i = 1 + 阻塞率 为拥塞惩罚。均衡时所有有流量的服务器代价相同、没有流量的服务器空载代价更高，
+ * 即存在水位 t 使 x_i = max(0, mu_i - a_i * t) 且 sum(x_i) = 总请求速率
+ *
+ * 不创建线程：求解注册在全局时间轮上，模拟模式下由离散事件模拟器触发；
+ * 服务器状态按列（SoA）收集在预先分配好的数组中，水位用二分法求解，每一步都是对数组的一次无分支遍历，可以被编译器向量化
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Server.h"
+
+/*
+ * Wardrop 均衡的数值求解，纯函数，不依赖服务器
+ */
+namespace wardrop
+{
+    /*
+     * 求均衡水位 t：sum(max(0, capacity[i] - penalty[i] * t)) = demand
+     * penalty[i] 必须为正，demand 必须小于 sum(capacity)；先二分到相对误差 1e-9，再在确定的活跃集合上求精确解
+     */
+    double SolveLevel(const double* capacity, const double* penalty, size_t n, double demand);
+
+    /* 水位为 t 时每个服务器分到的流量 */
+    void Flows(const double* capacity, const double* penalty, size_t n, double t, double* flow);
+}
+
+class GameSolver
+{
+public:
+    static GameSolver& Instance();  // 单例模式
+
+    void Init(const std::vector<std::shared_ptr<Server>>& server_pool);
+    void Stop();
+
+    /* 立即求解一次并发布权重 */
+    void SolveOnce();
+
+    /* get 最近一次求解的均衡水位和总请求速率 */
+    double GetLevel() const { return level_; }
+    double GetDemand() const { return demand_; }
+
+private:
+    GameSolver();
+
+    TimerHandle timer_;     // 每个博弈周期求解一次的定时器
+    std::mutex  mutex_;     // 串行化求解，并保证 Stop() 返回后不再有求解在执行
+    bool        shutdown_;
+
+    std::vector<std::shared_ptr<Server>>    servers_;
+
+    /* 按列存放的服务器状态和求解结果，Init() 时分配，之后每个周期复用 */
+    std::vector<double> capacity_;  // 有效处理能力 mu_i，单位 请求/s
+    std::vector<double> penalty_;   // 拥塞惩罚 a_i
+    std::vector<double> flow_;      // 均衡时的请求速率 x_i
+    std::vector<int>    weights_;   // 发布给负载均衡器的权重
+
+    std::atomic<double> level_;
+    std::atomic<double> demand_;
+};
+
+#endif //TINYEDGEPLAYER_GAME_SOLVER_H
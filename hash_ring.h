@@ -0,0 +1,103 @@
+#ifndef TINYEDGEPLAYER_HASH_RING_H
+#define TINYEDGEPLAYER_HASH_RING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+/*
+ * 一致性哈希环（带虚拟节点）
+ * 每个节点在环上放 vnodes 个点，键顺时针找到的第一个点所属的节点即为它的归属；虚拟节点越多，各节点分到的键越均匀
+ *
+ * 构建后只读，可以被多个线程同时 Lookup()；节点的加入和移除不修改原来的环，而是生成一个新环（配合 RcuPtr 整体发布）：
+ * 加入时只为新节点计算和排序 vnodes 个点，再与原有的点做一次归并，O(R + V log V)，
+ * 移除时只过滤掉该节点的点，O(R)，都不需要重新计算其它节点的哈希
+ */
+class HashRing
+{
+public:
+    /* 64 位整数混合（splitmix64 的终结步骤），用于键和虚拟节点的哈希 */
+    static uint64_t Hash(uint64_t x)
+    {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    HashRing() = default;
+
+    bool Empty() const { return points_.empty(); }
+
+    /* get 环上的点数 */
+    size_t Size() const { return points_.size(); }
+
+    /*
+     * 返回加入节点 node 之后的新环，node 在环上放 vnodes 个点
+     * 点的位置只取决于 seed（应在节点的整个生命周期内保持不变，例如服务器 ID），与节点加入的先后顺序无关
+     */
+    HashRing WithNode(uint32_t node, uint64_t seed, unsigned vnodes) const
+    {
+        std::vector<Point> added;
+        added.reserve(vnodes);
+        for (unsigned r = 0; r < vnodes; ++ r)
+            added.push_back(Point{Hash(seed << 32 | r), node});
+        std::sort(added.begin(), added.end());
+
+        HashRing ring;
+        ring.points_.reserve(points_.size() + added.size());
+        std::merge(points_.begin(), points_.end(), added.begin(), added.end(), std::back_inserter(ring.points_));
+        return ring;
+    }
+
+    /* 返回移除节点 node 的所有点之后的新环 */
+    HashRing WithoutNode(uint32_t node) const
+    {
+        HashRing ring;
+        ring.points_.reserve(points_.size());
+        std::copy_if(points_.begin(), points_.end(), std::back_inserter(ring.points_),
+                     [node](const Point& p) { return p.node != node; });
+        return ring;
+    }
+
+    /*
+     * 从键的哈希位置起顺时针遍历环，返回第一个 accept(node) 为 true 的节点
+     * 有界负载的一致性哈希（Mirrokni et al., "Consistent Hashing with Bounded Loads", 2018）用 accept 跳过已满的节点；
+     * 所有节点都不被接受时返回键原本归属的节点。环不能为空
+     */
+    template<typename Accept>
+    uint32_t Lookup(uint64_t key, Accept accept) const
+    {
+        uint64_t h = Hash(key);
+        auto first = std::lower_bound(points_.begin(), points_.end(), Point{h, 0});
+        size_t start = first == points_.end() ? 0 : first - points_.begin();
+        size_t n = points_.size();
+
+        for (size_t k = 0; k < n; ++ k)
+        {
+            size_t i = start + k < n ? start + k : start + k - n;
+            if (accept(points_[i].node))
+                return points_[i].node;
+        }
+
+        return points_[start].node;
+    }
+
+private:
+    struct Point
+    {
+        uint64_t    hash;   // 在环上的位置
+        uint32_t    node;   // 所属的节点
+
+        bool operator<(const Point& other) const
+        {
+            return hash != other.hash ? hash < other.hash : node < other.node;
+        }
+    };
+
+    std::vector<Point>  points_;    // 按位置排列
+};
+
+#endif //TINYEDGEPLAYER_HASH_RING_H
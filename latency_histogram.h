@@ -0,0 +1,171 @@
+#ifndef TINYEDGEPLAYER_LATENCY_HISTOGRAM_H
+#define TINYEDGEPLAYER_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+ * 延迟直方图（HDR 风格的对数分桶）
+ * 小于 16 的值每个值一个桶；之后每个 2 的幂区间再均分为 16 个子桶，相对误差不超过 1/16，
+ * 528 个桶即可覆盖 0 ~ 2^36（以 us 计约 19 小时），更大的值记入最后一个桶
+ *
+ * 记录端无锁：直方图分为若干分片，每个线程固定写自己对应的分片，只做 relaxed 的 fetch_add；
+ * 读取时把所有分片合并为一个 Snapshot，再在快照上计算平均值和分位数
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr unsigned   kSubBucketBits = 4;
+    static constexpr unsigned   kSubBucketCount = 1u << kSubBucketBits;
+    static constexpr unsigned   kMaxExponent = 35;
+    static constexpr size_t     kBucketCount = kSubBucketCount * (kMaxExponent - kSubBucketBits + 2);
+
+    /*
+     * 合并后的直方图，可以自由拷贝
+     * 两个快照相减可以得到一段时间内的直方图（max 除外，它始终是截至较新快照的最大值）
+     */
+    struct Snapshot
+    {
+        Snapshot() : counts(), count(0), sum(0), max(0) {}
+
+        /* 平均值，没有样本时返回 0 */
+        double Mean() const
+        {
+            return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+        }
+
+        /* 第 p 百分位数（0 < p <= 100），返回所在桶的上界，没有样本时返回 0 */
+        uint64_t Percentile(double p) const
+        {
+            if (count == 0)
+                return 0;
+
+            uint64_t rank = static_cast<uint64_t>(p / 100.0 * count + 0.5);
+            if (rank < 1)
+                rank = 1;
+
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBucketCount; ++ i)
+            {
+                seen += counts[i];
+                if (seen >= rank)
+                {
+                    uint64_t value = BucketUpperBound(i);
+                    return value < max ? value : max;
+                }
+            }
+
+            return max;
+        }
+
+        /* 减去一个较早的快照 */
+        void Subtract(const Snapshot& earlier)
+        {
+            for (size_t i = 0; i < kBucketCount; ++ i)
+                counts[i] -= earlier.counts[i];
+            count -= earlier.count;
+            sum -= earlier.sum;
+        }
+
+        std::array<uint64_t, kBucketCount>  counts;
+        uint64_t    count;
+        uint64_t    sum;
+        uint64_t    max;
+    };
+
+    /* shard_count 一般取记录线程的数量，单线程记录时取 1 即可 */
+    explicit LatencyHistogram(size_t shard_count = 1)
+        : shard_count_(shard_count == 0 ? 1 : shard_count),
+          shards_(new Shard[shard_count_]())
+    {}
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    void operator=(const LatencyHistogram&) = delete;
+
+    /* 记录一个样本 */
+    void Record(uint64_t value)
+    {
+        Shard& shard = shards_[ThreadIndex() % shard_count_];
+
+        shard.counts[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.count.fetch_add(1, std::memory_order_relaxed);
+        shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t max = shard.max.load(std::memory_order_relaxed);
+        while (value > max && !shard.max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+            ;
+    }
+
+    /* 合并所有分片；与 Record() 并发时得到的是一个近似的快照 */
+    Snapshot Collect() const
+    {
+        Snapshot snapshot;
+
+        for (size_t s = 0; s < shard_count_; ++ s)
+        {
+            const Shard& shard = shards_[s];
+
+            for (size_t i = 0; i < kBucketCount; ++ i)
+                snapshot.counts[i] += shard.counts[i].load(std::memory_order_relaxed);
+            snapshot.count += shard.count.load(std::memory_order_relaxed);
+            snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+
+            uint64_t max = shard.max.load(std::memory_order_relaxed);
+            if (max > snapshot.max)
+                snapshot.max = max;
+        }
+
+        return snapshot;
+    }
+
+    /* 值所在的桶 */
+    static size_t BucketIndex(uint64_t value)
+    {
+        if (value < kSubBucketCount)
+            return value;
+
+        unsigned exponent = 63 - __builtin_clzll(value);
+        if (exponent > kMaxExponent)
+            return kBucketCount - 1;
+
+        unsigned shift = exponent - kSubBucketBits;
+        return kSubBucketCount * (shift + 1) + ((value >> shift) - kSubBucketCount);
+    }
+
+    /* 桶中能放的最大值 */
+    static uint64_t BucketUpperBound(size_t index)
+    {
+        if (index < kSubBucketCount)
+            return index;
+
+        unsigned shift = index / kSubBucketCount - 1;
+        uint64_t lower = (kSubBucketCount + index % kSubBucketCount) << shift;
+        return lower + (uint64_t(1) << shift) - 1;
+    }
+
+private:
+    /* 每个分片独占缓存行，不同线程的记录互不干扰 */
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t>   counts[kBucketCount];
+        std::atomic<uint64_t>   count;
+        std::atomic<uint64_t>   sum;
+        std::atomic<uint64_t>   max;
+    };
+
+    /* 当前线程的序号，第一次调用时分配，用来选择分片 */
+    static unsigned ThreadIndex()
+    {
+        static std::atomic<unsigned> next(0);
+        static thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    size_t                      shard_count_;
+    std::unique_ptr<Shard[]>    shards_;
+};
+
+#endif //TINYEDGEPLAYER_LATENCY_HISTOGRAM_H
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <csignal>
 
@@ -10,19 +11,46 @@
 #include "Server.h"
 #include "Monitor.h"
 #include "balancer.h"
+#include "executor.h"
+#include "game_solver.h"
+#include "server_table.h"
+#include "simulator.h"
+#include "timer_wheel.h"
 
 // TODO: Client的数量不需太多，当前发送请求的时间时隔还比较大（减少这个间隔以节省线程）
 
-DEFINE_string(balancer, "random", "负载均衡算法，可选值：random, round, game, power");
+DEFINE_string(balancer, "random", "负载均衡算法，即在 BalancerRegistry 中注册的策略名，内置：random, round, game, power, least（最少未完成请求）, jsq（JSQ(d)）, ewma（Peak-EWMA 响应时间）, chash（有界负载的一致性哈希）");
+DEFINE_int32(jsq_d, 2, "jsq 负载均衡算法每次比较的服务器数量 d，最大为 Config::kMaxJsqChoices");
+DEFINE_int32(rate_burst, 1, "每台服务器限流器的突发大小（令牌数），默认为1，即不允许突发");
+DEFINE_bool(rate_by_cost, false, "是否按请求的计算开销收取令牌（每 Config::kRateTokenTime ms 一个），即按工作量而不是请求数量限流");
+DEFINE_string(clock, "monotonic", "限流器和线程池时间戳使用的时间源，可选值：monotonic（CLOCK_MONOTONIC）, coarse（CLOCK_MONOTONIC_COARSE，精度为一个时钟中断）, tsc（校准后的 rdtsc）");
+DEFINE_int32(global_qps, 0, "所有服务器合计的限流值，0 表示不限制");
+DEFINE_int32(client_qps, 0, "单个客户端在单个服务器上的限流值，0 表示不限制");
+DEFINE_int32(power_k, 2, "power 负载均衡算法每次比较的服务器数量 k，最大为 Config::kMaxJsqChoices");
+DEFINE_string(power_score, "block", "power 负载均衡算法的得分，可选值：block（阻塞率）, queue（每个核心上的未完成请求数量）, load（CPU 负载）, mix（按 --power_weights 加权求和）");
+DEFINE_string(power_weights, "1,1,1", "power_score=mix 时阻塞率、未完成请求数量、CPU 负载的权重，用逗号分隔");
+DEFINE_int32(ewma_k, 2, "ewma 负载均衡算法每次比较的服务器数量 k，最大为 Config::kMaxJsqChoices");
+DEFINE_int32(ewma_tau, 1000, "响应时间 Peak-EWMA 的衰减时间常数，单位 ms");
+DEFINE_double(chash_epsilon, 0.25, "chash 负载均衡算法的负载上限，每个服务器不超过平均负载的 (1 + epsilon) 倍");
+DEFINE_int32(snapshot_period, 100, "服务器状态快照表的采集周期，单位 ms；power 负载均衡算法和监测器读取快照");
 DEFINE_int32(server, 3, "服务器数量，默认为5");
 DEFINE_int32(client, 5, "客户端数量，默认为5");
 DEFINE_int32(request, 500, "每个客户端发送的请求数量，默认为100");
+DEFINE_int32(batch, 1, "客户端每次突发发送的请求数量，大于1时整批发往同一个服务器，默认为1");
 DEFINE_bool(verbose, false, "是否打开啰嗦模式");
+DEFINE_string(queue, "shared", "线程池任务队列模式，可选值：shared, steal, ring, priority, edf");
+DEFINE_int32(queue_capacity, 256, "ring 模式下每个线程池任务队列的容量，队满时拒绝新请求");
+DEFINE_int32(deadline, 100, "请求的截止期限（相对入队时间），单位 ms，默认为 Config::kLatencyThreshold");
+DEFINE_bool(drop_expired, false, "是否在执行前丢弃已经超过截止期限的请求");
+DEFINE_bool(shared_executor, false, "是否让所有服务器的 CPU 核心作为逻辑容量共用一个进程级执行器（线程数为硬件并发数），而不是各自创建线程");
+DEFINE_bool(simulate, false, "是否使用离散事件模拟：任务耗时、请求间隔、GC 和监测周期都在虚拟时钟上推进，不再真实等待");
+DEFINE_string(game_selector, "alias", "Game 算法按权重选择服务器的方式，可选值：queue（按轮生成服务器队列）, alias（别名表加权随机，选择不加锁，默认）, swrr（堆实现的平滑加权轮询，每次选择加锁）");
 
 // 服务端和客户端
 std::vector<std::shared_ptr<Server>> server_pool;
 std::vector<std::thread> clients;
 bool shutdown = false;      // TODO: 控制客户端退出，多个进程间共享即可。只有主进程会对它进行修改
+int active_clients = 0;     // 模拟模式下还没有发送完请求的客户端数量
 
 
 
@@ -40,26 +68,44 @@ void InitPools()
 
 
 /*
- * 发送一个请求给客户端
+ * 客户端 client 发送一个请求
  * 同时具有客户端和负载均衡器的功能
  */
-void SendRequest()
+void SendRequest(uint32_t client)
 {
     auto task = GenerateRandomTask();       // 生成任务请求
+    task.client = client;
 
-    int offset = Balancer::Instance().SelectOneServer();     // 选择处理请求的服务器
+    auto server = Balancer::Instance().SelectOneServer(task.key);     // 选择处理请求的服务器
 
     //if (g_config.Verbose)
-    //    LOG(INFO) << "Select Server[" << offset << "]";
+    //    LOG(INFO) << "Select Server[" << server->GetId() << "]";
 
+    // 由上一步选择的服务器处理生成的请求
+    // 有界队列模式下队满的服务器直接拒绝请求，而不是无限制地缓存
+    if (g_config.PoolQueueMode == QueueMode::BoundedRing)
+        server->TryPost(task);
+    else
+        server->Post(task);
+}
 
-    std::ostringstream client_id;
-    client_id << std::this_thread::get_id();
-
+/*
+ * 客户端 client 一次突发发送 count 个请求
+ * 整批请求只做一次服务器选择，并通过 Server::ExecuteBatch 一次性提交
+ */
+void SendRequestBatch(std::vector<Task>& batch, int count, uint32_t client)
+{
+    batch.clear();
+    for (int i = 0; i < count; ++ i)
+    {
+        batch.emplace_back(GenerateRandomTask());
+        batch.back().client = client;
+    }
 
-    std::string log;
+    // 整批请求发往同一个服务器，按第一个请求的键选择
+    auto server = Balancer::Instance().SelectOneServer(batch.front().key);
 
-    server_pool[offset]->Execute(task);  // 由上一步选择的服务器处理生成的请求
+    server->ExecuteBatch(batch);
 }
 
 /*
@@ -69,29 +115,152 @@ void InitClients()
 {
     for (int j = 0; j < FLAGS_client; ++ j)
     {
-        clients.emplace_back(std::thread([](){
+        uint32_t client = j + 1;    // 客户端编号从 1 开始
+        clients.emplace_back(std::thread([client](){
+            if (FLAGS_batch > 1)
+            {   // 突发模式：平均发送速率不变，每 batch * 20ms 发送一批
+                std::vector<Task> batch;
+                batch.reserve(FLAGS_batch);
+
+                for (int i = 0; i < FLAGS_request; i += FLAGS_batch)
+                {
+                    if (shutdown)
+                        return;
+
+                    SendRequestBatch(batch, std::min(FLAGS_batch, FLAGS_request - i), client);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(Config::kRequestInterval * FLAGS_batch));
+                }
+                return;
+            }
+
             for (int i = 0; i < FLAGS_request; ++ i)
             {
                 if (shutdown)
                     return;
 
-                SendRequest();
+                SendRequest(client);
                 std::this_thread::sleep_for(std::chrono::milliseconds(20));
             }
         }));
     }
 }
 
+/*
+ * 模拟模式下的客户端 client：已经发送了 sent 个请求，发送下一个（或下一批）请求后，在虚拟时间上等待发送间隔再继续
+ */
+void SimulateClient(uint32_t client, int sent)
+{
+    if (shutdown || sent >= FLAGS_request)
+    {
+        active_clients--;
+        return;
+    }
+
+    int count = 1;
+    if (FLAGS_batch > 1)
+    {
+        std::vector<Task> batch;
+        count = std::min(FLAGS_batch, FLAGS_request - sent);
+        SendRequestBatch(batch, count, client);
+    }
+    else
+    {
+        SendRequest(client);
+    }
+
+    Simulator::Instance().Schedule(std::chrono::milliseconds(Config::kRequestInterval * count), [client, sent, count]() {
+        SimulateClient(client, sent + count);
+    });
+}
+
+/*
+ * 运行离散事件模拟，直到所有客户端发送完请求并且所有服务器都处理完任务
+ */
+void RunSimulation()
+{
+    auto& sim = Simulator::Instance();
+
+    active_clients = FLAGS_client;
+    for (int j = 0; j < FLAGS_client; ++ j)
+    {
+        uint32_t client = j + 1;
+        sim.Schedule(0, [client]() { SimulateClient(client, 0); });
+    }
+
+    // GC 和监测是永不停止的周期事件，需要定期检查实验是否已经结束
+    sim.Every(std::chrono::milliseconds(100), [&sim]() {
+        if (active_clients > 0)
+            return true;
+
+        for (const auto& server : server_pool)
+        {
+            if (!server->IsIdle())
+                return true;
+        }
+
+        sim.Stop();
+        return false;
+    });
+
+    sim.Run();
+
+    LOG(INFO) << "Simulation finished: " << sim.Now() / 1e9 << "s virtual time, "
+              << sim.GetEventCount() << " events";
+}
+
+/*
+ * 延迟直方图的分位数，单位换算为 ms
+ */
+std::string LatencyPercentiles(const LatencyHistogram::Snapshot& h)
+{
+    return "p50=" + std::to_string(h.Percentile(50) / 1000.0)
+           + " p95=" + std::to_string(h.Percentile(95) / 1000.0)
+           + " p99=" + std::to_string(h.Percentile(99) / 1000.0)
+           + " p999=" + std::to_string(h.Percentile(99.9) / 1000.0) + " ms";
+}
+
 /*
  * 停止所有Server
  */
 void StopServers()
 {
+    unsigned throttled[kRateLevelCount] = {};
+
     for (const auto& server : server_pool)
     {
         LOG(INFO) << "server[" << server->GetId() << "] is stopping";
         server->Stop();
+
+        if (server->GetRejectedTaskCount() > 0)
+            LOG(INFO) << "server[" << server->GetId() << "] rejected " << server->GetRejectedTaskCount() << " tasks";
+
+        if (server->GetExpiredTaskCount() > 0)
+            LOG(INFO) << "server[" << server->GetId() << "] expired " << server->GetExpiredTaskCount()
+                      << " tasks, dropped " << server->GetDroppedTaskCount();
+
+        LOG(INFO) << "server[" << server->GetId() << "] queue wait " << LatencyPercentiles(server->GetQueueWaitHistogram());
+        LOG(INFO) << "server[" << server->GetId() << "] total time " << LatencyPercentiles(server->GetTotalTimeHistogram());
+
+        uint64_t hits = server->GetCacheHitCount(), misses = server->GetCacheMissCount();
+        if (hits + misses > 0)
+            LOG(INFO) << "server[" << server->GetId() << "] cache hit " << hits << "/" << hits + misses
+                      << " (" << 100.0 * hits / (hits + misses) << "%)";
+
+        unsigned client = server->GetThrottledCount(RateLevel::Client);
+        unsigned own = server->GetThrottledCount(RateLevel::Server);
+        unsigned global = server->GetThrottledCount(RateLevel::Global);
+        if (client + own + global > 0)
+            LOG(INFO) << "server[" << server->GetId() << "] throttled client=" << client << " server=" << own
+                      << " global=" << global;
+
+        throttled[static_cast<int>(RateLevel::Client)] += client;
+        throttled[static_cast<int>(RateLevel::Server)] += own;
+        throttled[static_cast<int>(RateLevel::Global)] += global;
     }
+
+    LOG(INFO) << "throttled client=" << throttled[static_cast<int>(RateLevel::Client)]
+              << " server=" << throttled[static_cast<int>(RateLevel::Server)]
+              << " global=" << throttled[static_cast<int>(RateLevel::Global)];
 }
 
 
@@ -105,7 +274,14 @@ void PrintStatus()
 
     log_string += "服务器数量：" + std::to_string(FLAGS_server) + "\n";
     log_string += "客户端数量：" + std::to_string(FLAGS_client) + "\n";
-    log_string += "负载均衡算法：" + FLAGS_balancer + "\n";
+    log_string += "负载均衡算法：" + Balancer::Instance().GetPolicy() + (FLAGS_balancer == "game" ? "（" + FLAGS_game_selector + "）" : "")
+                  + (FLAGS_balancer == "jsq" ? "（d=" + std::to_string(FLAGS_jsq_d) + "）" : "")
+                  + (FLAGS_balancer == "ewma" ? "（k=" + std::to_string(FLAGS_ewma_k) + ", tau=" + std::to_string(FLAGS_ewma_tau) + "ms）" : "")
+                  + (FLAGS_balancer == "chash" ? "（epsilon=" + std::to_string(FLAGS_chash_epsilon) + "）" : "") + "\n";
+    log_string += "任务队列模式：" + FLAGS_queue + "\n";
+    log_string += "离散事件模拟：" + std::string(FLAGS_simulate ? "是" : "否") + "\n";
+    log_string += "共享执行器：" + std::string(g_config.Backend() == PoolBackend::Executor
+                                          ? std::to_string(Executor::Instance().GetThreadCount()) + "个线程" : "否") + "\n";
 
     log_string + "-----------------------------------";
 
@@ -141,9 +317,17 @@ void ExitGracefully(int signum = 0) // 异常退出不应该走这个流程
 
     // 先停止Server，再停止Monitor
     // 顺序不要颠倒，否则在等待Server停止的过程中没有日志输出
+    GameSolver::Instance().Stop();
+    ServerTable::Instance().Stop();
     StopServers();
     Monitor::Instance().Stop();
 
+    // 所有服务器都已停止，先停掉时间轮，再停共享执行器，避免到期的回调投递给已经停止的 worker
+    if (!g_config.Simulate)
+        TimerWheel::Instance().Shutdown();
+    if (g_config.Backend() == PoolBackend::Executor)
+        Executor::Instance().Shutdown();
+
     // 打印统计信息
     Balancer::Instance().PrintStatistics();
     task::PrintStatistics();
@@ -165,6 +349,34 @@ void AbnormalSignalHandler(int signum)
     ExitGracefully(signum);
 }
 
+/*
+ * 根据 --power_score 和 --power_weights 设置 power 负载均衡算法的得分权重
+ */
+void SetPowerScore(const std::string& score, const std::string& weights)
+{
+    double block = 0, queue = 0, load = 0;
+
+    if (score == "queue")
+        queue = 1;
+    else if (score == "load")
+        load = 1;
+    else if (score == "mix")
+    {
+        char comma;
+        std::istringstream in(weights);
+        if (!(in >> block >> comma >> queue >> comma >> load))
+        {
+            LOG(ERROR) << "无法解析 --power_weights=" << weights << "，已使用 1,1,1";
+            block = queue = load = 1;
+        }
+    }
+    else
+        block = 1;
+
+    g_config.PowerBlockWeight = block;
+    g_config.PowerQueueWeight = queue;
+    g_config.PowerLoadWeight = load;
+}
 
 
 /*
@@ -183,6 +395,46 @@ int main(int argc, char* argv[])
     if (FLAGS_verbose)
         g_config.Verbose = true;
 
+    if (FLAGS_queue == "steal")
+        g_config.PoolQueueMode = QueueMode::WorkStealing;
+    else if (FLAGS_queue == "ring")
+        g_config.PoolQueueMode = QueueMode::BoundedRing;
+    else if (FLAGS_queue == "priority")
+        g_config.PoolQueueMode = QueueMode::Priority;
+    else if (FLAGS_queue == "edf")
+        g_config.PoolQueueMode = QueueMode::Deadline;
+    else
+        g_config.PoolQueueMode = QueueMode::Shared;
+    g_config.QueueCapacity = FLAGS_queue_capacity;
+    g_config.TaskDeadline = FLAGS_deadline;
+    g_config.DropExpiredTasks = FLAGS_drop_expired;
+    g_config.Simulate = FLAGS_simulate;
+    g_config.SharedExecutor = FLAGS_shared_executor;
+    g_config.JsqChoices = FLAGS_jsq_d > 0 ? FLAGS_jsq_d : 1;
+    g_config.PeakEwmaChoices = FLAGS_ewma_k > 0 ? FLAGS_ewma_k : 1;
+    g_config.PeakEwmaTau = FLAGS_ewma_tau > 0 ? FLAGS_ewma_tau : 1;
+    g_config.HashLoadEpsilon = FLAGS_chash_epsilon > 0 ? FLAGS_chash_epsilon : 0;
+    g_config.SnapshotPeriod = FLAGS_snapshot_period > 0 ? FLAGS_snapshot_period : 1;
+    g_config.RateBurst = FLAGS_rate_burst > 0 ? FLAGS_rate_burst : 1;
+    g_config.RateByCost = FLAGS_rate_by_cost;
+    if (FLAGS_clock == "coarse")
+        g_config.Clock = ClockSource::MonotonicCoarse;
+    else if (FLAGS_clock == "tsc")
+        g_config.Clock = ClockSource::Tsc;
+    else
+        g_config.Clock = ClockSource::Monotonic;
+    MonotonicClock::setSource(g_config.Clock);
+    g_config.GlobalRateLimit = FLAGS_global_qps > 0 ? FLAGS_global_qps : 0;
+    g_config.ClientRateLimit = FLAGS_client_qps > 0 ? FLAGS_client_qps : 0;
+    g_config.PowerChoices = FLAGS_power_k > 0 ? FLAGS_power_k : 1;
+    SetPowerScore(FLAGS_power_score, FLAGS_power_weights);
+    if (FLAGS_game_selector == "queue")
+        g_config.GameSelectorMode = GameSelector::Queue;
+    else if (FLAGS_game_selector == "swrr")
+        g_config.GameSelectorMode = GameSelector::SmoothWrr;
+    else
+        g_config.GameSelectorMode = GameSelector::Alias;
+
     // 注册手动停止程序的信号handler
     signal(SIGINT, AbnormalSignalHandler);
     signal(SIGABRT, AbnormalSignalHandler);
@@ -190,21 +442,33 @@ int main(int argc, char* argv[])
     // 初始化服务端
     InitPools();
 
+    // 初始化服务器状态快照表，负载均衡器和监测器都读取它
+    ServerTable::Instance().Init(server_pool);
+
     // 初始化负载均衡器
     Balancer::Instance().Init(server_pool);
-    if (FLAGS_balancer == "round")
-        Balancer::Instance().SetLoadBlanceAlgorithm(LoadBalanceAlgorithm::RoundRobin);
-    else if (FLAGS_balancer == "power")
-        Balancer::Instance().SetLoadBlanceAlgorithm(LoadBalanceAlgorithm::Power);
-    else if (FLAGS_balancer == "game")
-        Balancer::Instance().SetLoadBlanceAlgorithm(LoadBalanceAlgorithm::Game);
-    else
-        Balancer::Instance().SetLoadBlanceAlgorithm(LoadBalanceAlgorithm::Random);
+    if (!Balancer::Instance().SetPolicy(FLAGS_balancer))
+    {   // 策略由 BalancerRegistry 按名字查找，未注册的名字退回随机算法
+        std::string names;
+        for (const auto& name : BalancerRegistry::Instance().GetNames())
+            names += " " + name;
+        LOG(ERROR) << "未知的负载均衡算法 " << FLAGS_balancer << "，可选值：" << names << "，已使用 random";
+    }
+
 
+    // 初始化博弈求解器，每个博弈周期计算一次服务器权重
+    if (g_config.GameMode)
+        GameSolver::Instance().Init(server_pool);
 
     // 初始化监测器
     Monitor::Instance().Init(server_pool);
 
+    if (FLAGS_simulate)
+    {   // 模拟模式下客户端是事件链而不是线程，在当前线程中运行到实验结束
+        RunSimulation();
+        ExitGracefully(0);
+    }
+
     // 初始化客户端
     InitClients();
 
@@ -0,0 +1,139 @@
+#ifndef TINYEDGEPLAYER_MPMC_RING_H
+#define TINYEDGEPLAYER_MPMC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "rate_limiter/sequence.h"
+
+/*
+ * 有界无锁多生产者多消费者环形队列（Dmitry Vyukov 的 bounded MPMC queue）
+ * 每个格子带一个序号，生产者和消费者各自只对 enqueue_pos_ / dequeue_pos_ 做一次 CAS
+ * 队满时 TryPush() 立即失败，调用方据此实现背压
+ *
+ * 与 rate_limiter/sequence.h 一样，用前后填充把两个游标分别放在独立的缓存行上，避免伪共享
+ */
+template<typename T>
+class MpmcRing
+{
+public:
+    /* 容量会向上取整为2的幂 */
+    explicit MpmcRing(size_t capacity)
+        : mask_(RoundUpToPowerOfTwo(capacity < 2 ? 2 : capacity) - 1),
+          cells_(new Cell[mask_ + 1]),
+          enqueue_pos_(0),
+          dequeue_pos_(0)
+    {
+        for (size_t i = 0; i <= mask_; ++ i)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    void operator=(const MpmcRing&) = delete;
+
+    /* 入队，队满时返回 false */
+    bool TryPush(T data)
+    {
+        Cell* cell;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+            if (dif == 0)
+            {   // 格子空闲，抢占这个位置
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+            {   // 格子还没被消费者取走，队满
+                return false;
+            }
+            else
+            {   // 被别的生产者抢先了
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = data;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* 出队，队空时返回 false */
+    bool TryPop(T& data)
+    {
+        Cell* cell;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+            if (dif == 0)
+            {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+            {   // 格子还没被生产者填上，队空
+                return false;
+            }
+            else
+            {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+
+        data = cell->data;
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* 当前元素数量（并发修改时为近似值，但不会超过容量） */
+    size_t Size() const
+    {
+        size_t enqueue = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t dequeue = dequeue_pos_.load(std::memory_order_relaxed);
+
+        if (enqueue <= dequeue)
+            return 0;
+        return enqueue - dequeue > Capacity() ? Capacity() : enqueue - dequeue;
+    }
+
+    size_t Capacity() const { return mask_ + 1; }
+
+private:
+    static size_t RoundUpToPowerOfTwo(size_t n)
+    {
+        size_t result = 1;
+        while (result < n)
+            result <<= 1;
+        return result;
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t>     sequence;
+        T                       data;
+    };
+
+private:
+    char                        front_padding_[CACHELINE_SIZE_BYTES];
+    const size_t                mask_;
+    std::unique_ptr<Cell[]>     cells_;
+    char                        enqueue_padding_[CACHELINE_SIZE_BYTES - sizeof(size_t) - sizeof(std::unique_ptr<Cell[]>)];
+    std::atomic<size_t>         enqueue_pos_;
+    char                        dequeue_padding_[CACHELINE_SIZE_BYTES - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t>         dequeue_pos_;
+    char                        back_padding_[CACHELINE_SIZE_BYTES - sizeof(std::atomic<size_t>)];
+};
+
+#endif //TINYEDGEPLAYER_MPMC_RING_H
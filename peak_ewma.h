@@ -0,0 +1,86 @@
+#ifndef TINYEDGEPLAYER_PEAK_EWMA_H
+#define TINYEDGEPLAYER_PEAK_EWMA_H
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+/*
+ * 对峰值敏感的指数加权移动平均（Peak-EWMA），用来估计服务器的响应时间
+ * 新样本大于当前估计值时直接取新样本（立即反映变慢），否则按 w = exp(-Δt/tau) 衰减：value = value * w + sample * (1 - w)；
+ * 读取时把当前估计值按距上次更新的时间向 0 衰减，长时间没有完成任务的服务器估计值会逐渐变小，重新得到被尝试的机会
+ *
+ * 估计值（float）和上次更新的时间戳（uint32，单位 100us，约 5 天回绕一次）合在一个 8 字节的原子变量中，
+ * 多个线程可以同时 Observe() 和 Get()，更新用 CAS 完成，不加锁、不做内存分配
+ * 时间戳由调用方提供，可以是真实时间也可以是模拟器的虚拟时间，只要同一个对象始终使用同一个时钟即可
+ */
+class PeakEwma
+{
+public:
+    /* tau_ms 为衰减时间常数，单位 ms */
+    explicit PeakEwma(double tau_ms = 1000) : tau_ms_(tau_ms > 0 ? tau_ms : 1), state_(State{0, 0}) {}
+
+    PeakEwma(const PeakEwma&) = delete;
+    void operator=(const PeakEwma&) = delete;
+
+    /* set 衰减时间常数，单位 ms；应在开始 Observe() 之前设置 */
+    void SetTau(double tau_ms) { tau_ms_ = tau_ms > 0 ? tau_ms : 1; }
+
+    /* 把估计值重置为 value，并以 now_us 作为上次更新的时间 */
+    void Reset(double value, uint64_t now_us)
+    {
+        state_.store(State{static_cast<float>(value), Stamp_(now_us)}, std::memory_order_relaxed);
+    }
+
+    /* 加入一个样本 */
+    void Observe(double sample, uint64_t now_us)
+    {
+        State old = state_.load(std::memory_order_relaxed);
+        State next;
+
+        do
+        {
+            double value = sample > old.value ? sample : Decay_(old, sample, now_us);
+            uint32_t stamp = Stamp_(now_us);
+            if (static_cast<int32_t>(stamp - old.stamp) < 0)
+                stamp = old.stamp;      // 时间戳不后退
+            next = State{static_cast<float>(value), stamp};
+        }
+        while (!state_.compare_exchange_weak(old, next, std::memory_order_relaxed));
+    }
+
+    /* 在 now_us 时刻的估计值（已经按时间向 0 衰减），不修改状态 */
+    double Get(uint64_t now_us) const
+    {
+        return Decay_(state_.load(std::memory_order_relaxed), 0, now_us);
+    }
+
+private:
+    static constexpr uint64_t kStampUnitUs = 100;   // 时间戳的精度
+
+    struct State
+    {
+        float       value;      // 估计值
+        uint32_t    stamp;      // 上次更新的时间，单位 kStampUnitUs
+    };
+
+    static_assert(sizeof(State) == 8, "PeakEwma::State 必须能放进一个 8 字节的原子变量");
+
+    static uint32_t Stamp_(uint64_t now_us) { return static_cast<uint32_t>(now_us / kStampUnitUs); }
+
+    /* 按距 s.stamp 的时间把 s.value 向 sample 衰减；时间倒退（并发更新的先后顺序不定）时视为没有经过时间 */
+    double Decay_(State s, double sample, uint64_t now_us) const
+    {
+        int32_t elapsed = static_cast<int32_t>(Stamp_(now_us) - s.stamp);
+        if (elapsed <= 0)
+            return s.value;
+
+        double w = std::exp(-elapsed * (kStampUnitUs / 1000.0) / tau_ms_);
+        return s.value * w + sample * (1 - w);
+    }
+
+    double              tau_ms_;
+    std::atomic<State>  state_;
+};
+
+#endif //TINYEDGEPLAYER_PEAK_EWMA_H
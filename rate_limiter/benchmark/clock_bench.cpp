@@ -0,0 +1,87 @@
+//时间源的开销和限流器的准确度
+//1、每个时间源连续读取kReads次，统计每次调用的平均耗时（ns）
+//2、每个时间源构造一个kLimitedQps的限流器：单个线程持续调用tryPass()一秒，统计通过数量的偏差；
+//   再用pass()通过kPasses个令牌，统计实际耗时相对理论耗时的偏差
+//   突发大小为kBurst，容纳CLOCK_MONOTONIC_COARSE一个时钟中断（4ms）内补充的令牌，否则粗粒度时钟每次跳变只能放行一个令牌
+
+#include "../clock.h"
+#include "../rate_limiter.h"
+
+#include <stdio.h>
+
+#include <chrono>
+
+static const int kReads = 1 << 24;
+static const int64_t kLimitedQps = 100000;
+static const int kPasses = 20000;
+static const int64_t kBurst = kLimitedQps * 4 / 1000;
+
+struct Source
+{
+	const char* name;
+	ClockSource source;
+};
+
+static double MeasureCallCost(ClockFunc func)
+{
+	int64_t sink = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < kReads; ++i)
+		sink += func();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	//防止循环被优化掉
+	if (sink == 42)
+		printf(" ");
+
+	return seconds * NS_PER_SECOND / kReads;
+}
+
+static double MeasureTryPassError(ClockSource source)
+{
+	RateLimiter limiter(kLimitedQps, kBurst, source);
+	int64_t passed = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	auto end = start + std::chrono::seconds(1);
+	while (std::chrono::steady_clock::now() < end)
+		passed += limiter.tryPass();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double expected = kLimitedQps * seconds;
+	return (passed - expected) / expected;
+}
+
+static double MeasurePassError(ClockSource source)
+{
+	RateLimiter limiter(kLimitedQps, kBurst, source);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < kPasses; ++i)
+		limiter.pass();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double expected = 1.0 * kPasses / kLimitedQps;
+	return (seconds - expected) / expected;
+}
+
+int main()
+{
+	const Source sources[] = {
+		{"monotonic", ClockSource::Monotonic},
+		{"coarse", ClockSource::MonotonicCoarse},
+		{"tsc", ClockSource::Tsc},
+	};
+
+	printf("%-10s %10s %16s %16s\n", "clock", "ns/call", "tryPass error", "pass error");
+	for (const auto& s : sources)
+	{
+		double cost = MeasureCallCost(clockFunc(s.source));
+		double tryPassError = MeasureTryPassError(s.source);
+		double passError = MeasurePassError(s.source);
+		printf("%-10s %10.2f %+15.3f%% %+15.3f%%\n", s.name, cost, tryPassError * 100, passError * 100);
+	}
+
+	return 0;
+}
@@ -0,0 +1,109 @@
+//限流器的多线程扩展性
+//1、吞吐量：限定值远高于实际速率（不会被限流），每个线程连续调用tryPass()，统计所有线程合计的每秒调用次数
+//2、准确度：限定值为kLimitedQps，所有线程持续调用tryPass()一秒，统计实际通过的数量与限定值的偏差
+//分别测量RateLimiter和ShardedRateLimiter
+
+#include "../rate_limiter.h"
+#include "../sharded_rate_limiter.h"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+static const int64_t kUnlimitedQps = NS_PER_SECOND;
+static const int64_t kLimitedQps = 1000000;
+static const int kCallsPerThread = 1 << 22;
+
+//用threads个线程各调用kCallsPerThread次，返回每秒的调用次数
+template<typename Limiter>
+static double MeasureThroughput(Limiter& limiter, unsigned threads)
+{
+	std::atomic<unsigned> ready(0);
+	std::atomic<bool> go(false);
+	std::atomic<int64_t> sink(0);
+	std::vector<std::thread> workers;
+
+	for (unsigned t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([&]() {
+			ready.fetch_add(1);
+			while (!go.load(std::memory_order_acquire))
+				;
+
+			int64_t passed = 0;
+			for (int i = 0; i < kCallsPerThread; ++i)
+				passed += limiter.tryPass();
+			sink.fetch_add(passed, std::memory_order_relaxed);
+		});
+	}
+
+	while (ready.load() < threads)
+		;
+
+	auto start = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+
+	for (auto& w : workers)
+		w.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return 1.0 * threads * kCallsPerThread / seconds;
+}
+
+//用threads个线程持续调用一秒，返回通过的数量相对限定值的偏差
+template<typename Limiter>
+static double MeasureError(Limiter& limiter, unsigned threads)
+{
+	std::atomic<bool> stop(false);
+	std::atomic<int64_t> passed(0);
+	std::vector<std::thread> workers;
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned t = 0; t < threads; ++t)
+	{
+		workers.emplace_back([&]() {
+			int64_t local = 0;
+			while (!stop.load(std::memory_order_relaxed))
+				local += limiter.tryPass();
+			passed.fetch_add(local);
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	stop.store(true);
+	for (auto& w : workers)
+		w.join();
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double expected = kLimitedQps * seconds;
+	return (passed.load() - expected) / expected;
+}
+
+template<typename Limiter>
+static void Run(const char* name, unsigned maxThreads)
+{
+	for (unsigned threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		Limiter unlimited(kUnlimitedQps);
+		Limiter limited(kLimitedQps);
+
+		double rate = MeasureThroughput(unlimited, threads);
+		double error = MeasureError(limited, threads);
+		printf("%-10s %8u %16.0f %+11.3f%%\n", name, threads, rate, error * 100);
+	}
+}
+
+int main()
+{
+	unsigned maxThreads = std::max(2u, std::thread::hardware_concurrency()) * 2;
+
+	printf("%-10s %8s %16s %12s\n", "limiter", "threads", "calls/s", "error");
+	Run<RateLimiter>("global", maxThreads);
+	Run<ShardedRateLimiter>("sharded", maxThreads);
+
+	return 0;
+}
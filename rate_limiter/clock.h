@@ -0,0 +1,153 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define CLOCK_HAS_TSC 1
+#else
+#define CLOCK_HAS_TSC 0
+#endif
+
+#define CLOCK_NS_PER_SECOND 1000000000
+
+//时间源
+//所有时间源的返回值单位都是ns，起点都是CLOCK_MONOTONIC的起点，可以互相比较，也可以直接用于clock_nanosleep(CLOCK_MONOTONIC)
+//  Monotonic      ：clock_gettime(CLOCK_MONOTONIC)，精确到ns，vDSO调用约20ns
+//  MonotonicCoarse：clock_gettime(CLOCK_MONOTONIC_COARSE)，只读取内核上一次时钟中断时的时间，开销最小，但精度只有一个时钟中断（通常1~4ms）
+//  Tsc            ：rdtsc读取CPU时间戳计数器，按第一次使用时校准的频率换算为ns；CPU不支持恒定速率的TSC时退回Monotonic
+enum class ClockSource
+{
+    Monotonic,
+    MonotonicCoarse,
+    Tsc,
+};
+
+typedef int64_t (*ClockFunc)();
+
+inline int64_t monotonicNow()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * CLOCK_NS_PER_SECOND + ts.tv_nsec;
+}
+
+inline int64_t monotonicCoarseNow()
+{
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * CLOCK_NS_PER_SECOND + ts.tv_nsec;
+}
+
+#if CLOCK_HAS_TSC
+//TSC的校准结果：ns = baseNs + (tsc - baseTsc) * mult / 2^32
+struct TscCalibration
+{
+    bool usable;        //CPU支持恒定速率的TSC（invariant TSC）
+    uint64_t baseTsc;
+    int64_t baseNs;
+    uint64_t mult;
+
+    TscCalibration() : usable(false), baseTsc(0), baseNs(0), mult(0)
+    {
+        //CPUID 0x80000007 EDX bit 8：TSC以恒定速率计数，不受变频和休眠影响
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8)))
+        {
+            return;
+        }
+
+        //用CLOCK_MONOTONIC测量10ms内TSC走过的计数
+        uint64_t tsc0 = __rdtsc();
+        int64_t ns0 = monotonicNow();
+
+        struct timespec ts = {0, 10000000};
+        ::nanosleep(&ts, nullptr);
+
+        uint64_t tsc1 = __rdtsc();
+        int64_t ns1 = monotonicNow();
+
+        if (tsc1 <= tsc0 || ns1 <= ns0)
+        {
+            return;
+        }
+
+        mult = (static_cast<uint64_t>(ns1 - ns0) << 32) / (tsc1 - tsc0);
+        baseTsc = tsc1;
+        baseNs = ns1;
+        usable = true;
+    }
+
+    static const TscCalibration& instance()
+    {
+        static TscCalibration calibration;
+        return calibration;
+    }
+};
+#endif
+
+inline int64_t tscNow()
+{
+#if CLOCK_HAS_TSC
+    const TscCalibration& c = TscCalibration::instance();
+    if (!c.usable)
+    {
+        return monotonicNow();
+    }
+
+    //乘积超过64位，用128位整数计算
+    unsigned __int128 delta = __rdtsc() - c.baseTsc;
+    return c.baseNs + static_cast<int64_t>((delta * c.mult) >> 32);
+#else
+    return monotonicNow();
+#endif
+}
+
+//时间源对应的函数；选择Tsc时在这里完成校准（约10ms），之后的调用不再等待
+inline ClockFunc clockFunc(ClockSource source)
+{
+    switch (source)
+    {
+    case ClockSource::MonotonicCoarse:
+        return monotonicCoarseNow;
+    case ClockSource::Tsc:
+        tscNow();
+        return tscNow;
+    default:
+        return monotonicNow;
+    }
+}
+
+//std::chrono的时钟适配器，时间源由setSource()在运行时选择（默认Monotonic）
+//供需要std::chrono::time_point的地方使用，例如线程池中任务的入队时间
+struct MonotonicClock
+{
+    typedef std::chrono::nanoseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<MonotonicClock> time_point;
+    static const bool is_steady = true;
+
+    static time_point now()
+    {
+        return time_point(duration(func().load(std::memory_order_relaxed)()));
+    }
+
+    //应该在开始记录时间之前调用；各个时间源的起点相同，中途切换也不会使时间倒退很多
+    static void setSource(ClockSource source)
+    {
+        func().store(clockFunc(source));
+    }
+
+private:
+    static std::atomic<ClockFunc>& func()
+    {
+        static std::atomic<ClockFunc> f(monotonicNow);
+        return f;
+    }
+};
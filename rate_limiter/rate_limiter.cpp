@@ -1,116 +1,259 @@
 //@author liuyukang
 
 #include "rate_limiter.h"
-#include "spinlock_guard.h"
 
-#include <sys/time.h>
-#include <float.h>
-#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
 
-#define RETRY_IMMEDIATELY_TIMES 100//不睡眠的最大重试获得令牌的次数
+#define WAKEUP_SLACK_NS 50000//睡眠的唤醒误差（Linux默认的timer slack），最后这段时间让出CPU等待
 
  //qps限制最大为十亿
-RateLimiter::RateLimiter(int64_t qps) : 
-    bucketSize_(1), tokenLeft_(0), supplyUnitTime_(NS_PER_SECOND / qps), lastAddTokenTime_(0)
+RateLimiter::RateLimiter(int64_t qps, int64_t burst, ClockSource source) : 
+    bucketSize_(burst > 0 ? burst : 1), tat_(0), supplyUnitTime_(NS_PER_SECOND / qps),
+    systemClock_(clockFunc(source)), clock_(nullptr)
 { 
     assert(qps <= NS_PER_SECOND);
 	assert(qps >= 0);
-    lastAddTokenTime_ = now();
+    tat_.store(now());
 }
 
 void RateLimiter::SetQps(int64_t qps)
 {
-	supplyUnitTime_ = NS_PER_SECOND / qps;
+	//已经预约的令牌不变，之后的预约按新的速率排队
+	supplyUnitTime_.store(NS_PER_SECOND / qps);
+}
+
+void RateLimiter::SetQps(int64_t qps, int64_t burst)
+{
+	bucketSize_.store(burst > 0 ? burst : 1);
+	SetQps(qps);
+}
+
+void RateLimiter::SetClock(int64_t (*clock)())
+{
+	clock_.store(clock);
+	//换了时间源，之前的理论到达时间已经没有意义
+	tat_.store(now());
 }
 
 int64_t RateLimiter::now()
 {
-	struct timeval tv;
-	::gettimeofday(&tv, 0);
-	int64_t seconds = tv.tv_sec;
-	return seconds * NS_PER_SECOND + tv.tv_usec * NS_PER_USECOND;
+	auto clock = clock_.load(std::memory_order_relaxed);
+	if (clock != nullptr)
+	{
+		return clock();
+	}
+
+	//单调时钟，与clock_nanosleep使用同一个时钟，不受系统时间调整影响
+	return systemClock_();
 }
 
 //对外接口，能返回说明流量在限定值内
 void RateLimiter::pass()
 {
-	return mustGetToken();
+	waitUntil(reserve(1));
 }
 
-//尝试获得令牌
-//成功获得则返回true
-//失败则返回false
-bool RateLimiter::tryGetToken()
+void RateLimiter::pass(int64_t n)
 {
-    supplyTokens();
-
-	//获得一个令牌
-	auto token = tokenLeft_.fetch_add(-1);
-	if(token <= 0)
-	{//已经没有令牌了，归还透支的令牌
-		tokenLeft_.fetch_add(1);
-		return false;
+	if (n <= 0)
+	{
+		return;
 	}
-	
-    return true;
+
+	waitUntil(reserve(n));
 }
 
-//必定成功获得令牌
-//其中会进行重试操作
-void RateLimiter::mustGetToken()
+//预约n个令牌
+//从max(TAT, 当前时间, notBefore)开始连续占用n个补充周期，第n个令牌在占用开始后(n-1)个周期、再提前一个容忍度生效
+int64_t RateLimiter::reserve(int64_t n, int64_t notBefore)
 {
-	bool isGetToken = false;
-	for(int i = 0; i < RETRY_IMMEDIATELY_TIMES; ++i)
+	auto cur = now();
+	if (notBefore > cur)
 	{
-		isGetToken =  tryGetToken();
-		if(isGetToken)
-		{
-			return;
+		cur = notBefore;
+	}
+	if (n <= 0)
+	{
+		return cur;
+	}
+
+	auto interval = supplyUnitTime_.load();
+	auto tolerance = (bucketSize_.load() - 1) * interval;
+
+	auto tat = tat_.load();
+	int64_t start;
+	do
+	{
+		start = tat > cur ? tat : cur;
+	} while (!tat_.compare_exchange(tat, start + n * interval));
+
+	auto ready = start + (n - 1) * interval - tolerance;
+	return ready > cur ? ready : cur;
+}
+
+//尝试获得n个令牌
+//与reserve()相同，但令牌还没有生效时不修改TAT
+bool RateLimiter::tryPass(int64_t n)
+{
+	if (n <= 0)
+	{
+		return true;
+	}
+
+	auto cur = now();
+	auto interval = supplyUnitTime_.load();
+	auto tolerance = (bucketSize_.load() - 1) * interval;
+
+	auto tat = tat_.load();
+	int64_t start;
+	do
+	{
+		start = tat > cur ? tat : cur;
+		if (start + (n - 1) * interval - tolerance > cur)
+		{//令牌还没有生效
+			return false;
 		}
+	} while (!tat_.compare_exchange(tat, start + n * interval));
+
+	return true;
+}
+
+bool RateLimiter::tryBorrow(int64_t n)
+{
+	if (n <= 0)
+	{
+		return true;
 	}
 
-	while(1)
+	auto cur = now();
+	auto interval = supplyUnitTime_.load();
+	auto tolerance = (bucketSize_.load() - 1) * interval;
+
+	auto tat = tat_.load();
+	int64_t start;
+	do
 	{
-		isGetToken =  tryGetToken();
-		if(isGetToken)
-		{
+		start = tat > cur ? tat : cur;
+		if (start - tolerance > cur)
+		{//第一个令牌还没有生效
+			return false;
+		}
+	} while (!tat_.compare_exchange(tat, start + n * interval));
+
+	return true;
+}
+
+void RateLimiter::giveBack(int64_t n)
+{
+	if (n <= 0)
+	{
+		return;
+	}
+
+	auto cur = now();
+	auto interval = supplyUnitTime_.load();
+
+	auto tat = tat_.load();
+	int64_t back;
+	do
+	{
+		if (tat <= cur)
+		{//桶已经满了，归还的令牌没有地方放
 			return;
 		}
-		else
+
+		back = tat - n * interval;
+		if (back < cur)
 		{
-			//让出CPU
-			sleep(0);
+			back = cur;
+		}
+	} while (!tat_.compare_exchange(tat, back));
+}
+
+int RateLimiter::tryPassAll(RateLimiter* const* path, int depth, int64_t n)
+{
+	for (int i = 0; i < depth; ++i)
+	{
+		if (!path[i]->tryPass(n))
+		{//tryPass()占用的令牌可以用giveBack()原样归还
+			for (int j = 0; j < i; ++j)
+			{
+				path[j]->giveBack(n);
+			}
+			return i;
 		}
 	}
+
+	return -1;
 }
 
-void RateLimiter::supplyTokens()
+int RateLimiter::passAll(RateLimiter* const* path, int depth, int64_t n)
 {
-	auto cur = now();
-	if (cur - lastAddTokenTime_ < supplyUnitTime_)
+	int64_t when = 0;
+	int latest = reserveAll(path, depth, n, &when);
+
+	if (latest >= 0)
 	{
-		return;
+		path[latest]->waitUntil(when);
 	}
 
+	return latest;
+}
+
+int RateLimiter::reserveAll(RateLimiter* const* path, int depth, int64_t n, int64_t* when)
+{
+	int latest = -1;
+	int64_t release = 0;
+
+	for (int i = 0; i < depth; ++i)
 	{
-		SpinlockGuard lock(lock_);
-		//等待自旋锁期间可能已经补充过令牌了
-		int64_t newTokens = (cur - lastAddTokenTime_) / supplyUnitTime_;
-		if (newTokens <= 0)
+		//每一层都不早于前面各层的放行时刻预约，所以release单调不减
+		//不需要等待时reserve()返回的就是当时的时间或者release，不会晚于现在
+		auto ready = path[i]->reserve(n, release);
+		if (ready > release && ready > path[i]->now())
 		{
-			return;
+			latest = i;
 		}
-		
-		//更新补充时间,不能直接=cur，否则会导致时间丢失
-		lastAddTokenTime_ += (newTokens * supplyUnitTime_);
-		
-		auto freeRoom = bucketSize_ - tokenLeft_.load();
-		if(newTokens > freeRoom || newTokens > bucketSize_)
+		release = ready;
+	}
+
+	*when = release;
+	return latest;
+}
+
+void RateLimiter::waitUntil(int64_t when)
+{
+	if (clock_.load(std::memory_order_relaxed) != nullptr)
+	{//虚拟时钟不会在等待中前进
+		return;
+	}
+
+	//换算为CLOCK_MONOTONIC上的时刻：各时间源的起点相同，但TSC的校准频率可能有微小的误差，只使用时间差
+	auto remaining = when - now();
+	if (remaining <= 0)
+	{
+		return;
+	}
+
+	auto target = monotonicNow() + remaining;
+
+	if (remaining > WAKEUP_SLACK_NS)
+	{
+		struct timespec ts;
+		ts.tv_sec = (target - WAKEUP_SLACK_NS) / NS_PER_SECOND;
+		ts.tv_nsec = (target - WAKEUP_SLACK_NS) % NS_PER_SECOND;
+
+		//绝对时间睡眠，被信号打断后继续睡到同一时刻，不会累积误差
+		while (::clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
 		{
-			newTokens = freeRoom > bucketSize_ ? bucketSize_ : freeRoom;
 		}
-		
-		tokenLeft_.fetch_add(newTokens);
 	}
-	
-}
\ No newline at end of file
+
+	//剩下的时间不足一次睡眠的唤醒误差，让出CPU直到令牌生效
+	while (monotonicNow() < target)
+	{
+		::sched_yield();
+	}
+}
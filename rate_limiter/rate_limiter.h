@@ -1,10 +1,14 @@
 //@author liuyukang
 #pragma once
 
+#include "clock.h"
 #include "sequence.h"
-#include "spinlock.h"
+#include "utils.h"
 
 #include <assert.h>
+#include <stdint.h>
+
+#include <atomic>
 
 #define NS_PER_SECOND 1000000000//一秒的纳秒数
 #define NS_PER_USECOND 1000//一微秒的纳秒数
@@ -15,55 +19,91 @@
 //  RateLimiter r(100);
 //  r.pass();
 //  能通过r.pass()函数即可保证流速
+//  RateLimiter r(100, 10);//允许最多10个请求的突发
+//  r.pass(3);//一次获得3个令牌，例如按请求的开销收取令牌
 //特点：
 //  1、接口使用简单，无业务侵入，接入成本极低
 //  2、线程安全，CPU友好，性能强劲
 //  3、极轻量，核心代码150行
 //原理：
-//  基于令牌桶算法实现
+//  基于GCRA（通用信元速率算法，即虚拟调度形式的令牌桶）实现
+//  只维护一个理论到达时间TAT：每预约n个令牌，TAT后移n个补充周期；请求在TAT-容忍度时生效
+//  TAT用CAS更新，没有锁；pass()预约后用clock_nanosleep睡到令牌生效的时刻，等待期间不占用CPU
 class RateLimiter 
 {
 public:
     //qps限制最大为十亿
-    RateLimiter(int64_t qps);
+    //burst：令牌桶大小，即空闲之后最多可以不等待地连续通过的令牌数，默认为1（不允许突发）
+    //source：时间源，见clock.h
+    RateLimiter(int64_t qps, int64_t burst = 1, ClockSource source = ClockSource::Monotonic);
 
     DISALLOW_COPY_MOVE_AND_ASSIGN(RateLimiter);
 
     //对外接口，能返回说明流量在限定值内
     void pass();
 
+    //一次性获得n个令牌，用于批量请求
+    //预约n个令牌，睡到最后一个令牌生效
+    void pass(int64_t n);
+
+    //预约n个令牌，不等待，返回这些令牌生效的时间（与now()同一时间源，单位ns），不早于当前时间
+    //预约立即占用令牌，之后的预约排在它后面；调用者应在返回的时刻之后再放行请求
+    //notBefore：请求最早在这个时刻放行（例如分层限流中前面各层预约的时刻），令牌按这个时刻到达计算，返回值不早于它
+    int64_t reserve(int64_t n = 1, int64_t notBefore = 0);
+
+    //尝试获得n个令牌，从不等待
+    //令牌已经生效则占用并返回true，否则不占用并返回false；n个令牌一起占用，不会只占用一部分
+    //n大于突发大小时令牌永远不会同时生效，总是返回false，这样的请求应该使用pass(n)
+    bool tryPass(int64_t n = 1);
+
+    //尝试预支n个令牌，从不等待
+    //只要第一个令牌已经生效就占用全部n个，其余令牌从之后的补充周期中预支；用于分片限流器的租约
+    bool tryBorrow(int64_t n);
+
+    //归还预约了但没有用掉的n个令牌，TAT前移，最多移到当前时间（不会因此产生额外的突发）
+    void giveBack(int64_t n);
+
+    //分层限流：一次获取要同时通过path中的每一个限流器（例如 客户端 -> 服务器 -> 全局），不需要加锁
+    //tryPassAll：依次尝试每一层，某一层拿不到令牌时归还已经在前面各层拿到的令牌；全部通过返回-1，否则返回拒绝的层
+    static int tryPassAll(RateLimiter* const* path, int depth, int64_t n = 1);
+
+    //passAll：在每一层预约n个令牌，睡到最晚生效的时刻；返回令牌最晚生效的层，不需要等待时返回-1
+    static int passAll(RateLimiter* const* path, int depth, int64_t n = 1);
+
+    //reserveAll：依次在每一层预约n个令牌，不等待；每一层都从前面各层预约的时刻开始预约，令牌按请求真正放行的时刻消耗
+    //最终放行的时刻写入when，返回最后一个推迟放行时刻的层，不需要等待时返回-1
+    //不能阻塞的调用者（例如事件循环）据此把请求推迟到when再执行，令牌已经占用，届时不需要再次获取
+    static int reserveAll(RateLimiter* const* path, int depth, int64_t n, int64_t* when);
+
     void SetQps(int64_t qps);
 
-private:
+    //同时修改限定值和突发大小
+    void SetQps(int64_t qps, int64_t burst);
+
+    //替换时间源（返回值单位ns），例如离散事件模拟的虚拟时钟；传入nullptr则恢复为构造时选择的时间源
+    //虚拟时钟不会在等待中前进，此时pass()只预约不等待，应该使用tryPass()或reserve()
+    void SetClock(int64_t (*clock)());
 
     //获得当前时间，单位ns
     int64_t now();
 
-    //更新令牌桶中的令牌
-    void supplyTokens();
+private:
 
-    //尝试获得令牌
-    //成功获得则返回true
-    //失败则返回false
-    bool tryGetToken();
+    //睡到when（now()的时间），使用虚拟时钟时直接返回
+    void waitUntil(int64_t when);
 
-    //必定成功获得令牌
-    //其中会进行重试操作
-    void mustGetToken();
+    //令牌桶大小，即允许的突发令牌数
+    std::atomic<int64_t> bucketSize_;
 
-    //令牌桶大小
-    const int64_t bucketSize_;
-    
-    //剩下的token数
-    AtomicSequence tokenLeft_;
+    //理论到达时间TAT：下一个令牌在TAT-容忍度时生效，单位纳秒
+    AtomicSequence tat_;
 
     //补充令牌的单位时间
-    //const int64_t supplyUnitTime_;
-    int64_t supplyUnitTime_;
+    std::atomic<int64_t> supplyUnitTime_;
 
-    //上次补充令牌的时间，单位纳秒
-    int64_t lastAddTokenTime_;
+    //构造时选择的时间源，起点与CLOCK_MONOTONIC相同
+    const ClockFunc systemClock_;
 
-    //自旋锁
-    Spinlock lock_;
+    //替换的时间源，为nullptr时使用systemClock_
+    std::atomic<int64_t (*)()> clock_;
 };
\ No newline at end of file
@@ -31,6 +31,12 @@ public:
 		return _seq.fetch_add(increment);// _order);
 	}
 
+	//CAS：当前值等于expected时替换为desired并返回true，否则把当前值写入expected并返回false
+	bool compare_exchange(int64_t& expected, const int64_t desired)
+	{
+		return _seq.compare_exchange_weak(expected, desired);
+	}
+
 private:
 	//���߶����룬�Ա�֤_seq������������������һ��������
 	char _frontPadding[CACHELINE_PADDING_FOR_ATOMIC_INT64_SIZE];
@@ -0,0 +1,118 @@
+#include "sharded_rate_limiter.h"
+
+ShardedRateLimiter::ShardedRateLimiter(int64_t qps, int64_t batch, int64_t leaseNs, ClockSource source) :
+    global_(qps, 1, source), maxBatch_(batch > 0 ? batch : 1), leaseNs_(leaseNs > 0 ? leaseNs : 1), batch_(1), nextSweep_(0)
+{
+	batch_.store(batchFor(qps));
+}
+
+void ShardedRateLimiter::SetQps(int64_t qps)
+{
+	global_.SetQps(qps);
+	batch_.store(batchFor(qps));
+}
+
+int64_t ShardedRateLimiter::batchFor(int64_t qps) const
+{
+	//低qps下一批令牌要很久才能补充上，租用太多会让误差超出leaseNs内的补充量
+	int64_t supplied = qps * leaseNs_ / NS_PER_SECOND;
+	int64_t batch = supplied < maxBatch_ ? supplied : maxBatch_;
+	return batch > 1 ? batch : 1;
+}
+
+ShardedRateLimiter::Shard& ShardedRateLimiter::localShard()
+{
+	//线程第一次使用时依次分配分片，前kShards个线程各自独占一个
+	static std::atomic<unsigned> nextSlot(0);
+	static thread_local unsigned slot = nextSlot.fetch_add(1);
+	return shards_[slot % kShards];
+}
+
+//对外接口，能返回说明流量在限定值内
+void ShardedRateLimiter::pass()
+{
+	if (tryPass())
+	{
+		return;
+	}
+
+	//已经达到限定值，不再租用，直接从全局限流器等一个令牌
+	global_.pass();
+}
+
+bool ShardedRateLimiter::tryPass()
+{
+	Shard& shard = localShard();
+	auto cur = global_.now();
+
+	if (spend(shard, cur))
+	{
+		return true;
+	}
+
+	return renew(shard, cur);
+}
+
+bool ShardedRateLimiter::spend(Shard& shard, int64_t cur)
+{
+	if (cur >= shard.expire.load(std::memory_order_relaxed))
+	{
+		return false;
+	}
+
+	auto tokens = shard.tokens.load(std::memory_order_relaxed);
+	while (tokens > 0)
+	{
+		if (shard.tokens.compare_exchange_weak(tokens, tokens - 1, std::memory_order_relaxed))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ShardedRateLimiter::revoke(Shard& shard)
+{
+	auto left = shard.tokens.exchange(0);
+	if (left > 0)
+	{
+		global_.giveBack(left);
+	}
+}
+
+bool ShardedRateLimiter::renew(Shard& shard, int64_t cur)
+{
+	sweep(cur);
+
+	//剩下的令牌可能来自过期的租约，不能再花掉
+	revoke(shard);
+
+	auto batch = batch_.load(std::memory_order_relaxed);
+	if (!global_.tryBorrow(batch))
+	{
+		return false;
+	}
+
+	//先设置过期时间再放入令牌，其它共用分片的线程看到令牌时租约已经有效
+	shard.expire.store(cur + leaseNs_, std::memory_order_relaxed);
+	shard.tokens.fetch_add(batch - 1);
+	return true;
+}
+
+void ShardedRateLimiter::sweep(int64_t cur)
+{
+	auto next = nextSweep_.load(std::memory_order_relaxed);
+	if (cur < next || !nextSweep_.compare_exchange_strong(next, cur + leaseNs_))
+	{
+		return;
+	}
+
+	for (auto& shard : shards_)
+	{
+		if (cur >= shard.expire.load(std::memory_order_relaxed) && shard.tokens.load(std::memory_order_relaxed) > 0)
+		{
+			revoke(shard);
+		}
+	}
+}
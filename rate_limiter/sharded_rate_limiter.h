@@ -0,0 +1,88 @@
+#pragma once
+
+#include "rate_limiter.h"
+#include "utils.h"
+
+#include <stdint.h>
+
+#include <atomic>
+
+//分片限流器
+//用于很高的qps（每秒数百万次以上）下多个线程同时通过同一个限流器
+//使用：
+//  ShardedRateLimiter r(10000000);
+//  r.pass();
+//原理：
+//  全局限流器（RateLimiter）之外有kShards个分片，每个线程固定使用其中一个；
+//  线程从全局限流器一次租用一小批令牌（租约）放在自己的分片中，之后在分片内逐个花掉，不再访问全局的缓存行
+//  租约有时限：过期后没有用掉的令牌归还给全局限流器，不能再花掉
+//误差：
+//  租约中的令牌在租用时就从全局限流器中预支，因此任意时间窗口内通过的请求数最多比限定值多
+//  使用中的分片数 × (batch - 1) 个，且这些令牌最晚在租用后leaseNs内被花掉或归还
+//  batch和leaseNs越小误差越小、访问全局限流器越频繁；batch会被限制为不超过leaseNs内补充的令牌数
+class ShardedRateLimiter
+{
+public:
+    //qps限制最大为十亿
+    //batch：每次租用的令牌数；leaseNs：租约时限，单位ns；source：时间源，每次tryPass()都会读取一次
+    ShardedRateLimiter(int64_t qps, int64_t batch = 32, int64_t leaseNs = 1000000,
+                       ClockSource source = ClockSource::Monotonic);
+
+    DISALLOW_COPY_MOVE_AND_ASSIGN(ShardedRateLimiter);
+
+    //对外接口，能返回说明流量在限定值内
+    void pass();
+
+    //尝试获得一个令牌，从不等待
+    //成功获得则返回true，否则返回false
+    bool tryPass();
+
+    void SetQps(int64_t qps);
+
+    //分片数量，超过这个数量的线程会共用分片
+    static const int kShards = 64;
+
+private:
+
+    //每个分片独占缓存行，不同线程的分片之间没有伪共享
+    struct alignas(64) Shard
+    {
+        std::atomic<int64_t> tokens{0};     //租约中还没有花掉的令牌
+        std::atomic<int64_t> expire{0};     //租约过期的时间，单位ns
+    };
+
+    //当前线程使用的分片
+    Shard& localShard();
+
+    //从分片中花掉一个令牌，租约过期或令牌用完时返回false
+    bool spend(Shard& shard, int64_t cur);
+
+    //归还分片中没有用掉的令牌
+    void revoke(Shard& shard);
+
+    //租约过期或用完后续租：归还剩下的令牌，再租用一批，成功租到时已经花掉其中一个
+    bool renew(Shard& shard, int64_t cur);
+
+    //每隔leaseNs回收一次所有已经过期的租约，闲置线程的令牌也能按时归还
+    void sweep(int64_t cur);
+
+    //按qps限制每次租用的令牌数，不超过leaseNs内补充的令牌数
+    int64_t batchFor(int64_t qps) const;
+
+    //全局限流器
+    RateLimiter global_;
+
+    //配置的每次租用的令牌数
+    const int64_t maxBatch_;
+
+    //租约时限
+    const int64_t leaseNs_;
+
+    //实际每次租用的令牌数
+    std::atomic<int64_t> batch_;
+
+    //下一次回收过期租约的时间
+    std::atomic<int64_t> nextSweep_;
+
+    Shard shards_[kShards];
+};
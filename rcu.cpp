@@ -0,0 +1,140 @@
+#include "rcu.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <glog/logging.h>
+
+/* 线程在域中占用的槽，线程退出时归还 */
+struct EpochSlotOwner
+{
+    EpochDomain::Slot*  slot = nullptr;
+    unsigned            depth = 0;      // 读临界区的嵌套层数
+
+    ~EpochSlotOwner()
+    {
+        if (slot != nullptr)
+        {
+            slot->epoch.store(EpochDomain::kIdle, std::memory_order_release);
+            slot->used.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local EpochSlotOwner tls_epoch_slot;
+
+EpochDomain::EpochDomain()
+    : global_epoch_(1)
+{
+    for (auto& slot : slots_)
+    {
+        slot.epoch.store(kIdle, std::memory_order_relaxed);
+        slot.used.store(false, std::memory_order_relaxed);
+    }
+}
+
+EpochDomain::~EpochDomain()
+{
+    // 进程退出时不再有读者
+    for (auto& r : retired_)
+        r.deleter();
+}
+
+EpochDomain& EpochDomain::Instance()
+{
+    static EpochDomain d;
+    return d;
+}
+
+EpochDomain::Slot& EpochDomain::ThreadSlot_()
+{
+    if (tls_epoch_slot.slot != nullptr)
+        return *tls_epoch_slot.slot;
+
+    for (auto& slot : slots_)
+    {
+        bool expected = false;
+        if (!slot.used.load(std::memory_order_relaxed)
+            && slot.used.compare_exchange_strong(expected, true, std::memory_order_acquire))
+        {
+            tls_epoch_slot.slot = &slot;
+            return slot;
+        }
+    }
+
+    LOG(FATAL) << "EpochDomain: 同时做读操作的线程超过 " << kMaxThreads << " 个";
+    return slots_[0];
+}
+
+void EpochDomain::Enter_()
+{
+    if (tls_epoch_slot.depth++ > 0)
+        return;
+
+    // seq_cst 的写保证之后读指针不会被重排到记录 epoch 之前
+    ThreadSlot_().epoch.store(global_epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+void EpochDomain::Exit_()
+{
+    if (--tls_epoch_slot.depth > 0)
+        return;
+
+    tls_epoch_slot.slot->epoch.store(kIdle, std::memory_order_release);
+}
+
+uint64_t EpochDomain::MinActiveEpoch_() const
+{
+    uint64_t min = kIdle;
+
+    for (const auto& slot : slots_)
+    {
+        uint64_t e = slot.epoch.load(std::memory_order_seq_cst);
+        if (e < min)
+            min = e;
+    }
+
+    return min;
+}
+
+void EpochDomain::Retire(std::function<void ()> deleter)
+{
+    // 对象已经被摘下：在此之后进入临界区（epoch 更大）的读者都看不到它
+    uint64_t epoch = global_epoch_.fetch_add(1, std::memory_order_seq_cst);
+
+    {
+        std::lock_guard<std::mutex> guard(retired_mutex_);
+        retired_.push_back(Retired{epoch, std::move(deleter)});
+    }
+
+    Reclaim();
+}
+
+void EpochDomain::Reclaim()
+{
+    std::vector<Retired> ready;
+
+    {
+        std::lock_guard<std::mutex> guard(retired_mutex_);
+
+        if (retired_.empty())
+            return;
+
+        uint64_t min = MinActiveEpoch_();
+
+        // 所有读者的 epoch 都比摘下时大，旧对象不会再被访问
+        auto it = std::partition(retired_.begin(), retired_.end(), [min](const Retired& r) { return r.epoch >= min; });
+        std::move(it, retired_.end(), std::back_inserter(ready));
+        retired_.erase(it, retired_.end());
+    }
+
+    // 在锁外释放，deleter 里可以再调用 Retire()
+    for (auto& r : ready)
+        r.deleter();
+}
+
+size_t EpochDomain::GetPendingCount()
+{
+    std::lock_guard<std::mutex> guard(retired_mutex_);
+    return retired_.size();
+}
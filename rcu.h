@@ -0,0 +1,121 @@
+#ifndef TINYEDGEPLAYER_RCU_H
+#define TINYEDGEPLAYER_RCU_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*
+ * 基于 epoch 的内存回收（EBR），配合 RcuPtr 实现读多写少数据的 RCU 式发布
+ *
+ * 读者进入读临界区时把当前的全局 epoch 记录在自己线程的槽中，离开时清除，整个过程不加锁、不等待；
+ * 写者整体替换指针后把旧对象交给 Retire()：此时全局 epoch 前进一步，旧对象只可能被 epoch 不大于替换时刻的读者看到，
+ * 等所有这样的读者都离开临界区后才真正释放
+ *
+ * 进程内只有一个域；每个线程第一次进入读临界区时占用一个槽，线程退出时归还
+ */
+class EpochDomain
+{
+public:
+    static constexpr size_t     kMaxThreads = 1024;     // 同时做读操作的线程数量上限
+
+    static EpochDomain& Instance();
+
+    ~EpochDomain();
+
+    EpochDomain(const EpochDomain&) = delete;
+    void operator=(const EpochDomain&) = delete;
+
+    /*
+     * 读临界区，在作用域内读到的 RcuPtr 指向的对象都不会被释放
+     * 可以嵌套，只有最外层的进入和离开会修改槽
+     */
+    class ReadGuard
+    {
+    public:
+        ReadGuard() { EpochDomain::Instance().Enter_(); }
+        ~ReadGuard() { EpochDomain::Instance().Exit_(); }
+
+        ReadGuard(const ReadGuard&) = delete;
+        void operator=(const ReadGuard&) = delete;
+    };
+
+    /* 在所有可能还持有旧对象的读者离开之后调用 deleter，调用方必须已经把对象从 RcuPtr 中摘下 */
+    void Retire(std::function<void ()> deleter);
+
+    /* 释放所有已经安全的旧对象；Retire() 会顺便调用 */
+    void Reclaim();
+
+    /* get 等待释放的旧对象数量 */
+    size_t GetPendingCount();
+
+private:
+    static constexpr uint64_t   kIdle = UINT64_MAX;     // 槽不在读临界区中
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t>   epoch;      // 所在读临界区开始时的全局 epoch，不在临界区中时为 kIdle
+        std::atomic<bool>       used;       // 槽是否被某个线程占用
+    };
+
+    struct Retired
+    {
+        uint64_t                epoch;      // 摘下时的全局 epoch
+        std::function<void ()>  deleter;
+    };
+
+    EpochDomain();
+
+    void Enter_();
+    void Exit_();
+
+    /* 当前线程的槽，第一次调用时占用一个 */
+    Slot& ThreadSlot_();
+
+    /* 所有在临界区中的读者的最小 epoch，没有读者时为 kIdle */
+    uint64_t MinActiveEpoch_() const;
+
+    std::atomic<uint64_t>   global_epoch_;
+    Slot                    slots_[kMaxThreads];
+
+    std::mutex              retired_mutex_;
+    std::vector<Retired>    retired_;
+
+    friend struct EpochSlotOwner;
+};
+
+/*
+ * 由 EpochDomain 保护的指针
+ * 读者在 EpochDomain::ReadGuard 的作用域内调用 Load()，得到的对象在作用域结束前一直有效；
+ * 写者在旁边构建好新对象后调用 Publish() 整体替换，读者永远不会看到构建到一半的对象
+ */
+template<typename T>
+class RcuPtr
+{
+public:
+    explicit RcuPtr(T* p = nullptr) : ptr_(p) {}
+
+    ~RcuPtr() { delete ptr_.load(std::memory_order_relaxed); }
+
+    RcuPtr(const RcuPtr&) = delete;
+    void operator=(const RcuPtr&) = delete;
+
+    /* 必须在 ReadGuard 的作用域内调用 */
+    const T* Load() const { return ptr_.load(std::memory_order_seq_cst); }
+
+    /* 用 p 替换当前对象，旧对象在宽限期之后释放 */
+    void Publish(T* p)
+    {
+        T* old = ptr_.exchange(p, std::memory_order_seq_cst);
+        if (old != nullptr)
+            EpochDomain::Instance().Retire([old]() { delete old; });
+    }
+
+private:
+    std::atomic<T*>     ptr_;
+};
+
+#endif //TINYEDGEPLAYER_RCU_H
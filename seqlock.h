@@ -0,0 +1,78 @@
+#ifndef TINYEDGEPLAYER_SEQLOCK_H
+#define TINYEDGEPLAYER_SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * 顺序锁（seqlock）
+ * 单个写者发布一个小的、可平凡复制的值，任意多个读者无锁地读取它的一致快照
+ *
+ * 写者在写入前后各把序号加 1，读者在读取前后各读一次序号，两次相同且为偶数才说明读到的是完整的一份；
+ * 数据本身按 8 字节拆开存放在原子变量中，并发读写不构成数据竞争
+ * 参考 Boehm, "Can Seqlocks Get Along With Programming Language Memory Models?", MSPC'12
+ */
+template<typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock 只能存放可平凡复制的类型");
+
+public:
+    explicit SeqLock(const T& value = T()) : seq_(0)
+    {
+        Store(value);
+    }
+
+    SeqLock(const SeqLock&) = delete;
+    void operator=(const SeqLock&) = delete;
+
+    /* 写者：发布一个新值，同一时刻只能有一个写者 */
+    void Store(const T& value)
+    {
+        uint64_t buffer[kWords] = {};
+        std::memcpy(buffer, &value, sizeof(T));
+
+        uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < kWords; ++ i)
+            words_[i].store(buffer[i], std::memory_order_relaxed);
+
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    /* 读者：读取最近一次发布的值，与写者冲突时重试 */
+    T Load() const
+    {
+        uint64_t buffer[kWords];
+
+        while (true)
+        {
+            uint64_t begin = seq_.load(std::memory_order_acquire);
+            if (begin & 1)
+                continue;   // 写者正在写入
+
+            for (size_t i = 0; i < kWords; ++ i)
+                buffer[i] = words_[i].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == begin)
+                break;
+        }
+
+        T value;
+        std::memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t>   seq_;
+    std::atomic<uint64_t>   words_[kWords];
+};
+
+#endif //TINYEDGEPLAYER_SEQLOCK_H
@@ -0,0 +1,82 @@
+#include "server_table.h"
+
+#include "config.h"
+#include "simulator.h"
+#include "timer_wheel.h"
+
+ServerTable::ServerTable()
+    : shutdown_(false), version_(0)
+{}
+
+ServerTable& ServerTable::Instance()
+{
+    static ServerTable t;
+    return t;
+}
+
+void ServerTable::Init(const std::vector<std::shared_ptr<Server>>& server_pool)
+{
+    servers_ = server_pool;
+
+    // 先发布一份，策略和监测器从一开始就能读到快照
+    Refresh();
+
+    std::chrono::milliseconds period(g_config.SnapshotPeriod);
+
+    if (g_config.Simulate)
+    {
+        Simulator::Instance().Every(period, [this]() {
+            if (shutdown_)
+                return false;
+            Refresh();
+            return true;
+        });
+        return;
+    }
+
+    timer_ = TimerWheel::Instance().Every(period, [this]() {
+        if (!shutdown_)
+            Refresh();
+    });
+}
+
+void ServerTable::Stop()
+{
+    timer_.Cancel();
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    shutdown_ = true;
+}
+
+void ServerTable::Refresh()
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    size_t n = servers_.size();
+
+    // 在旁边生成新的快照，读者不会看到采集到一半的数组
+    auto snapshot = new ServerSnapshot();
+    snapshot->load.resize(n);
+    snapshot->block_rate.resize(n);
+    snapshot->ram_load.resize(n);
+    snapshot->speed.resize(n);
+    snapshot->avg_task_time.resize(n);
+    snapshot->cores.resize(n);
+
+    for (size_t i = 0; i < n; ++ i)
+    {
+        Server& s = *servers_[i];
+
+        snapshot->load[i] = s.GetLoad();
+        snapshot->block_rate[i] = s.GetBlockRate();
+        snapshot->ram_load[i] = s.GetRamLoad();
+        snapshot->speed[i] = s.GetCurrentSpeed();
+        snapshot->avg_task_time[i] = s.GetAvgTaskTime();
+        snapshot->cores[i] = s.GetCpuCoreCount();
+    }
+
+    snapshot->version = version_.load(std::memory_order_relaxed) + 1;
+
+    snapshot_.Publish(snapshot);
+    version_.store(snapshot->version, std::memory_order_release);
+}
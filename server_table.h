@@ -0,0 +1,69 @@
+#ifndef TINYEDGEPLAYER_SERVER_TABLE_H
+#define TINYEDGEPLAYER_SERVER_TABLE_H
+
+/*
+ * 服务器状态快照表
+ * 一个采集者按固定周期（g_config.SnapshotPeriod）读取所有服务器的状态，按列（SoA）写入连续的数组，
+ * 生成好之后通过 RcuPtr 整体发布；负载均衡策略和监测器读快照，不再逐个访问 Server 对象
+ *
+ * 快照比服务器上的实时状态最多滞后一个采集周期；需要精确未完成请求数量的策略（least、jsq、ewma、chash）仍读取实时计数
+ * 不创建线程：采集注册在全局时间轮上，模拟模式下由离散事件模拟器触发
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "rcu.h"
+#include "Server.h"
+
+/*
+ * 某一时刻所有服务器的状态，第 i 列对应服务器池中的第 i 个服务器
+ */
+struct ServerSnapshot
+{
+    uint64_t                version;        // 发布序号，从 1 开始递增
+
+    std::vector<double>     load;           // GetLoad()，即 CPU 负载
+    std::vector<double>     block_rate;     // GetBlockRate()
+    std::vector<double>     ram_load;       // GetRamLoad()
+    std::vector<double>     speed;          // GetCurrentSpeed()
+    std::vector<double>     avg_task_time;  // GetAvgTaskTime()，单位 ms
+    std::vector<unsigned>   cores;          // GetCpuCoreCount()
+
+    size_t Size() const { return load.size(); }
+};
+
+class ServerTable
+{
+public:
+    static ServerTable& Instance();     // 单例模式
+
+    void Init(const std::vector<std::shared_ptr<Server>>& server_pool);
+    void Stop();
+
+    /* 立即采集一次并发布 */
+    void Refresh();
+
+    /* 最近一次发布的快照，必须在 EpochDomain::ReadGuard 的作用域内调用；Init() 之前为 nullptr */
+    const ServerSnapshot* Load() const { return snapshot_.Load(); }
+
+    /* get 最近一次发布的序号，还没有发布过时为 0 */
+    uint64_t GetVersion() const { return version_.load(std::memory_order_acquire); }
+
+private:
+    ServerTable();
+
+    TimerHandle timer_;     // 周期采集的定时器
+    std::mutex  mutex_;     // 串行化采集，并保证 Stop() 返回后不再有采集在执行
+    bool        shutdown_;
+
+    std::vector<std::shared_ptr<Server>>    servers_;
+
+    RcuPtr<ServerSnapshot>  snapshot_;
+    std::atomic<uint64_t>   version_;
+};
+
+#endif //TINYEDGEPLAYER_SERVER_TABLE_H
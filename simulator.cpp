@@ -0,0 +1,52 @@
+#include "simulator.h"
+
+Simulator::Simulator()
+    : now_(0), next_seq_(0), event_count_(0), stopped_(false)
+{
+}
+
+Simulator& Simulator::Instance()
+{
+    static Simulator s;
+    return s;
+}
+
+void Simulator::Schedule(int64_t delay, Callback cb)
+{
+    ScheduleAt(now_ + (delay > 0 ? delay : 0), std::move(cb));
+}
+
+void Simulator::ScheduleAt(int64_t time, Callback cb)
+{
+    events_.push(Event{time < now_ ? now_ : time, next_seq_++, std::move(cb)});
+}
+
+void Simulator::Every(int64_t period, std::function<bool ()> cb)
+{
+    Schedule(period, [this, period, cb]() {
+        if (cb())
+            Every(period, cb);
+    });
+}
+
+void Simulator::Run()
+{
+    stopped_ = false;
+
+    while (!stopped_ && !events_.empty())
+    {
+        // priority_queue::top() 只能拿到 const 引用；移走回调不影响堆的排序（只依赖 time 和 seq），随后立即弹出
+        Event event = std::move(const_cast<Event&>(events_.top()));
+        events_.pop();
+
+        now_ = event.time;
+        event_count_++;
+
+        event.cb();
+    }
+}
+
+int64_t SimulatorNow()
+{
+    return Simulator::Instance().Now();
+}
@@ -0,0 +1,85 @@
+#ifndef TINYEDGEPLAYER_SIMULATOR_H
+#define TINYEDGEPLAYER_SIMULATOR_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+/*
+ * 离散事件模拟器
+ * 维护一个按触发时间排序的事件堆和一个虚拟时钟，Run() 在单个线程中依次弹出事件、把时钟拨到事件的触发时间并执行它
+ * 模拟模式下任务的执行时间、客户端的发送间隔、GC 和监测周期都变成事件，不再调用 sleep_for，也不需要额外的线程
+ *
+ * 除 Now() 外的接口都只能在运行 Run() 的线程（或 Run() 之前的主线程）中调用
+ */
+class Simulator
+{
+public:
+    using Callback = std::function<void ()>;
+
+    static Simulator& Instance();   // 单例模式
+
+    /* 当前虚拟时间，单位 ns，从 0 开始 */
+    int64_t Now() const { return now_; }
+
+    /* 在 delay 纳秒之后触发 cb */
+    void    Schedule(int64_t delay, Callback cb);
+
+    template<typename Rep, typename Period>
+    void    Schedule(std::chrono::duration<Rep, Period> delay, Callback cb)
+    {
+        Schedule(std::chrono::duration_cast<std::chrono::nanoseconds>(delay).count(), std::move(cb));
+    }
+
+    /* 在虚拟时间 time 触发 cb，time 早于当前时间时按当前时间处理 */
+    void    ScheduleAt(int64_t time, Callback cb);
+
+    /* 每隔 period 纳秒触发一次 cb，直到 cb 返回 false */
+    void    Every(int64_t period, std::function<bool ()> cb);
+
+    template<typename Rep, typename Period>
+    void    Every(std::chrono::duration<Rep, Period> period, std::function<bool ()> cb)
+    {
+        Every(std::chrono::duration_cast<std::chrono::nanoseconds>(period).count(), std::move(cb));
+    }
+
+    /* 执行事件直到事件堆为空或者调用了 Stop() */
+    void    Run();
+
+    /* 让 Run() 在当前事件执行完后返回 */
+    void    Stop() { stopped_ = true; }
+
+    /* 已经执行的事件数量 */
+    uint64_t GetEventCount() const { return event_count_; }
+
+private:
+    Simulator();
+
+    struct Event
+    {
+        int64_t     time;
+        uint64_t    seq;        // 同一时刻的事件按加入顺序执行
+        Callback    cb;
+    };
+
+    struct Later
+    {
+        bool operator()(const Event& a, const Event& b) const
+        {
+            return a.time != b.time ? a.time > b.time : a.seq > b.seq;
+        }
+    };
+
+    std::priority_queue<Event, std::vector<Event>, Later>   events_;
+    int64_t     now_;
+    uint64_t    next_seq_;
+    uint64_t    event_count_;
+    bool        stopped_;
+};
+
+/* 模拟时钟，可以作为 RateLimiter 的时间源 */
+int64_t SimulatorNow();
+
+#endif //TINYEDGEPLAYER_SIMULATOR_H
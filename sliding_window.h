@@ -0,0 +1,51 @@
+#ifndef TINYEDGEPLAYER_SLIDING_WINDOW_H
+#define TINYEDGEPLAYER_SLIDING_WINDOW_H
+
+#include <array>
+#include <cstddef>
+
+/*
+ * 定长滑动窗口
+ * 只保留最近 N 个样本，样本放在环形数组中并维护它们的和，Push() 和 Mean() 都是 O(1)，不做任何内存分配
+ *
+ * 自身不是线程安全的：只应由一个写者（例如线程池的 monitor）使用，读者通过 SeqLock 发布的快照获取结果
+ */
+template<typename T, size_t N>
+class SlidingWindow
+{
+    static_assert(N > 0, "SlidingWindow 的长度必须大于 0");
+
+public:
+    SlidingWindow() : samples_(), next_(0), size_(0), sum_() {}
+
+    /* 加入一个样本，窗口已满时挤掉最旧的样本 */
+    void Push(T value)
+    {
+        if (size_ == N)
+            sum_ -= samples_[next_];
+        else
+            ++ size_;
+
+        samples_[next_] = value;
+        sum_ += value;
+        next_ = (next_ + 1) % N;
+    }
+
+    bool    Empty() const { return size_ == 0; }
+    size_t  Size() const  { return size_; }
+    T       Sum() const   { return sum_; }
+
+    /* 样本的平均值，窗口为空时返回 0 */
+    double Mean() const
+    {
+        return size_ == 0 ? 0.0 : static_cast<double>(sum_) / size_;
+    }
+
+private:
+    std::array<T, N>    samples_;
+    size_t              next_;      // 下一个样本写入的位置
+    size_t              size_;
+    T                   sum_;       // 窗口内所有样本的和
+};
+
+#endif //TINYEDGEPLAYER_SLIDING_WINDOW_H
@@ -0,0 +1,119 @@
+#ifndef TINYEDGEPLAYER_TASK_QUEUE_H
+#define TINYEDGEPLAYER_TASK_QUEUE_H
+
+#include <algorithm>
+#include <vector>
+
+#include "config.h"
+#include "task_slot.h"
+
+/*
+ * 加锁模式（Shared / Priority / Deadline）下线程池使用的任务队列，自身不加锁，由线程池的 mutex_ 保护
+ *
+ * Shared   : 单个 FIFO
+ * Priority : 每个优先级一个 FIFO，出队时从优先级最高的非空队列中取
+ * Deadline : System 优先级的任务放在单独的 FIFO 中并最先执行，其余任务放进按截止期限排序的最小堆，
+ *            截止期限相同时优先级高的先执行，再相同则先入队的先执行
+ */
+class TaskQueue
+{
+public:
+    explicit TaskQueue(QueueMode mode = QueueMode::Shared, size_t reserve = 0)
+        : mode_(mode), size_(0)
+    {
+        if (mode_ == QueueMode::Deadline)
+            heap_.reserve(reserve);     // 预留到任务槽数量，正常情况下入队不会再分配内存
+    }
+
+    bool    empty() const { return size_ == 0; }
+    size_t  size() const  { return size_; }
+
+    void push(TaskSlot* slot)
+    {
+        ++ size_;
+
+        switch (mode_)
+        {
+        case QueueMode::Priority:
+            fifo_[static_cast<int>(slot->priority)].push_back(slot);
+            break;
+
+        case QueueMode::Deadline:
+            if (slot->priority == TaskPriority::System)
+            {
+                fifo_[0].push_back(slot);
+            }
+            else
+            {
+                heap_.push_back(slot);
+                std::push_heap(heap_.begin(), heap_.end(), Later);
+            }
+            break;
+
+        default:
+            fifo_[0].push_back(slot);
+            break;
+        }
+    }
+
+    /* 把 batch 中的任务全部入队，batch 被清空 */
+    void splice(TaskSlotQueue& batch)
+    {
+        if (mode_ == QueueMode::Shared)
+        {
+            size_ += batch.size();
+            fifo_[0].splice(batch);
+            return;
+        }
+
+        while (!batch.empty())
+            push(batch.pop_front());
+    }
+
+    /* 取出下一个要执行的任务，队列为空时返回 nullptr */
+    TaskSlot* pop()
+    {
+        if (size_ == 0)
+            return nullptr;
+
+        -- size_;
+
+        if (mode_ == QueueMode::Deadline)
+        {
+            if (!fifo_[0].empty())
+                return fifo_[0].pop_front();
+
+            std::pop_heap(heap_.begin(), heap_.end(), Later);
+            TaskSlot* slot = heap_.back();
+            heap_.pop_back();
+            return slot;
+        }
+
+        for (auto& fifo : fifo_)
+        {
+            if (!fifo.empty())
+                return fifo.pop_front();
+        }
+
+        return nullptr;     // 不会走到这里
+    }
+
+private:
+    /* 堆的比较函数：a 是否应该排在 b 之后执行 */
+    static bool Later(const TaskSlot* a, const TaskSlot* b)
+    {
+        if (a->deadline != b->deadline)
+            return a->deadline > b->deadline;
+        if (a->priority != b->priority)
+            return a->priority > b->priority;
+        return a->enter_time > b->enter_time;
+    }
+
+private:
+    QueueMode               mode_;
+    TaskSlotQueue           fifo_[kTaskPriorityCount];
+    std::vector<TaskSlot*>  heap_;
+    size_t                  size_;
+};
+
+#endif //TINYEDGEPLAYER_TASK_QUEUE_H
@@ -0,0 +1,240 @@
+#ifndef TINYEDGEPLAYER_TASK_SLOT_H
+#define TINYEDGEPLAYER_TASK_SLOT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "config.h"
+#include "rate_limiter/clock.h"
+
+/*
+ * 提交任务时的可选属性
+ */
+struct TaskOptions
+{
+    TaskOptions(TaskPriority p = TaskPriority::Normal, unsigned deadline = 0, unsigned service = 0)
+        : priority(p), deadline_ms(deadline), service_ms(service) {}
+
+    TaskPriority    priority;       // 优先级，Priority/Deadline 模式下决定执行顺序
+    unsigned        deadline_ms;    // 相对入队时间的截止期限，单位 ms；0 表示使用线程池的默认值
+    unsigned        service_ms;     // 任务占用一个核心的时间，单位 ms，仅 PoolBackend::Simulated 使用
+};
+
+/*
+ * 任务槽
+ * 线程池中每一个排队/执行中的任务都占用一个槽：闭包直接构造在槽内的定长缓冲区中（small-buffer），
+ * 入队时间也存放在槽内，槽本身通过 next 指针串成任务队列，因此提交任务时不需要任何堆分配
+ *
+ * 闭包超过 kStorageSize 时退化为在堆上构造，槽内只保存指针
+ */
+struct TaskSlot
+{
+    static constexpr size_t kStorageSize = 96;
+
+    TaskSlot()
+        : invoke(nullptr), destroy(nullptr), next(nullptr), group(nullptr),
+          priority(TaskPriority::Normal), deadline_ms(0), service_ms(0),
+          next_free(0), generation(0), remaining(0), pooled(false)
+    {}
+
+    TaskSlot(const TaskSlot&) = delete;
+    void operator=(const TaskSlot&) = delete;
+
+    /* 把可执行对象放进槽内 */
+    template<typename F>
+    void Emplace(F&& f)
+    {
+        using Fn = typename std::decay<F>::type;
+
+        if constexpr (sizeof(Fn) <= kStorageSize && alignof(Fn) <= alignof(std::max_align_t))
+        {
+            new (storage) Fn(std::forward<F>(f));
+            invoke = [](void* p) { (*static_cast<Fn*>(p))(); };
+            destroy = [](void* p) { static_cast<Fn*>(p)->~Fn(); };
+        }
+        else
+        {
+            new (storage) Fn*(new Fn(std::forward<F>(f)));
+            invoke = [](void* p) { (**static_cast<Fn**>(p))(); };
+            destroy = [](void* p) { delete *static_cast<Fn**>(p); };
+        }
+    }
+
+    /* 执行并析构槽内的可执行对象 */
+    void Run()
+    {
+        struct Destroyer
+        {
+            TaskSlot* slot;
+            ~Destroyer() { slot->Clear(); }
+        } destroyer{this};
+
+        invoke(storage);
+    }
+
+    /* 不执行，直接析构槽内的可执行对象 */
+    void Clear()
+    {
+        if (destroy != nullptr)
+            destroy(storage);
+
+        invoke = nullptr;
+        destroy = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char storage[kStorageSize];  // 闭包存储
+    void                    (*invoke)(void*);
+    void                    (*destroy)(void*);
+
+    MonotonicClock::time_point  enter_time;     // 入队时间
+    MonotonicClock::time_point  deadline;       // 截止期限，入队时根据 deadline_ms 计算
+    MonotonicClock::time_point  start_time;     // 开始执行的时间
+    TaskSlot*               next;           // 任务队列中的下一个槽
+    TaskSlot*               group;          // 批量提交时所属的聚合槽，任务完成时让它的 remaining 减 1
+    TaskPriority            priority;
+    unsigned                deadline_ms;    // 提交时指定的相对截止期限，0 表示使用线程池的默认值
+    unsigned                service_ms;     // 模拟模式下任务占用核心的时间
+
+    std::atomic<uint32_t>   next_free;      // 空闲链表中下一个槽的下标 + 1，0 表示没有
+    std::atomic<uint32_t>   generation;     // 每完成一次任务加 1，TaskHandle 据此判断任务是否完成
+    std::atomic<uint32_t>   remaining;      // 作为聚合槽时，批量任务中尚未完成的数量，减到 0 时聚合槽完成
+    uint32_t                index;          // 在 TaskSlab 中的下标
+    bool                    pooled;         // 是否来自 TaskSlab，否则为临时在堆上分配的槽
+};
+
+
+/*
+ * 预分配的任务槽池
+ * 空闲槽组成一个无锁栈（Treiber stack），栈顶带有版本号以避免 ABA 问题
+ */
+class TaskSlab
+{
+public:
+    explicit TaskSlab(size_t count)
+        : count_(count), slots_(new TaskSlot[count]), free_head_(0)
+    {
+        for (size_t i = 0; i < count_; ++ i)
+        {
+            slots_[i].index = static_cast<uint32_t>(i);
+            slots_[i].pooled = true;
+            slots_[i].next_free.store(i + 1 < count_ ? static_cast<uint32_t>(i + 2) : 0, std::memory_order_relaxed);
+        }
+
+        if (count_ > 0)
+            free_head_.store(1, std::memory_order_relaxed);
+    }
+
+    TaskSlab(const TaskSlab&) = delete;
+    void operator=(const TaskSlab&) = delete;
+
+    /* 取出一个空闲槽，没有空闲槽时返回 nullptr */
+    TaskSlot* Acquire()
+    {
+        uint64_t head = free_head_.load(std::memory_order_acquire);
+
+        while (true)
+        {
+            uint32_t top = static_cast<uint32_t>(head);
+            if (top == 0)
+                return nullptr;
+
+            TaskSlot* slot = &slots_[top - 1];
+            uint64_t new_head = ((head >> 32) + 1) << 32 | slot->next_free.load(std::memory_order_relaxed);
+
+            if (free_head_.compare_exchange_weak(head, new_head, std::memory_order_acquire, std::memory_order_acquire))
+                return slot;
+        }
+    }
+
+    /* 归还一个槽 */
+    void Release(TaskSlot* slot)
+    {
+        uint64_t head = free_head_.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            slot->next_free.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            uint64_t new_head = ((head >> 32) + 1) << 32 | (slot->index + 1);
+
+            if (free_head_.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed))
+                return;
+        }
+    }
+
+    size_t Capacity() const { return count_; }
+
+private:
+    size_t                          count_;
+    std::unique_ptr<TaskSlot[]>     slots_;
+    std::atomic<uint64_t>           free_head_;     // 高32位为版本号，低32位为栈顶槽的下标 + 1
+};
+
+
+/*
+ * 由 TaskSlot 串成的 FIFO 队列（侵入式链表），自身不加锁，由调用方保证互斥
+ */
+class TaskSlotQueue
+{
+public:
+    TaskSlotQueue() : head_(nullptr), tail_(nullptr), size_(0) {}
+
+    bool    empty() const { return size_ == 0; }
+    size_t  size() const  { return size_; }
+
+    TaskSlot* front() const { return head_; }
+
+    void push_back(TaskSlot* slot)
+    {
+        slot->next = nullptr;
+        if (tail_ == nullptr)
+            head_ = slot;
+        else
+            tail_->next = slot;
+        tail_ = slot;
+        ++ size_;
+    }
+
+    /* 把 other 中的所有槽按顺序接到队尾，other 被清空 */
+    void splice(TaskSlotQueue& other)
+    {
+        if (other.empty())
+            return;
+
+        if (tail_ == nullptr)
+            head_ = other.head_;
+        else
+            tail_->next = other.head_;
+        tail_ = other.tail_;
+        size_ += other.size_;
+
+        other.head_ = other.tail_ = nullptr;
+        other.size_ = 0;
+    }
+
+    TaskSlot* pop_front()
+    {
+        TaskSlot* slot = head_;
+        if (slot == nullptr)
+            return nullptr;
+
+        head_ = slot->next;
+        if (head_ == nullptr)
+            tail_ = nullptr;
+        slot->next = nullptr;
+        -- size_;
+        return slot;
+    }
+
+private:
+    TaskSlot*   head_;
+    TaskSlot*   tail_;
+    size_t      size_;
+};
+
+#endif //TINYEDGEPLAYER_TASK_SLOT_H
@@ -1,30 +1,104 @@
 #include "threadpool.h"
 #include "config.h"
+#include "executor.h"
+#include "simulator.h"
+#include "timer_wheel.h"
 
-#include <numeric>
+/* 当前线程所属的线程池及其在 stealing_workers_ 中的下标，仅 WorkStealing 模式的 worker 线程会设置 */
+static thread_local ThreadPool* tls_owner_pool = nullptr;
+static thread_local unsigned    tls_worker_index = 0;
 
-ThreadPool::ThreadPool(unsigned int threads_cnt)
-        :  cnt_threads_(threads_cnt),
-        avg_task_time_(50),
-        shutdown_(false),
-        power_(threads_cnt)
+/* 时长转换为 us，负值记为 0 */
+static uint64_t ToMicroseconds(MonotonicClock::duration d)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    return us > 0 ? static_cast<uint64_t>(us) : 0;
+}
+
+/* 合法的线程数量为 [1, 10)（每秒的统计由时间轮采样，不需要额外的线程），不合法时使用2个线程 */
+static unsigned ValidThreadCount(unsigned threads_cnt)
 {
-    // 线程数量最少为2
-    // 一个执行MonitorRoutine()，一个执行WorkerRoutine()
-    if (threads_cnt <= 1 || threads_cnt >= 10)
+    if (threads_cnt == 0 || threads_cnt >= 10)
     {
-        threads_cnt = 2;
         LOG(ERROR) << "线程数量不合法，已初始化为2个线程";
+        return 2;
     }
+    return threads_cnt;
+}
 
-    // 多出来一个线程作为monitor
-    for (unsigned i = 0; i < cnt_threads_ + 1; ++ i)
-    {
-        std::thread t([this](){this->_WorkerRoutine();});
-        worker_threads.emplace_back(std::move(t));
+ThreadPool::ThreadPool(unsigned int threads_cnt, QueueMode mode, size_t queue_capacity, size_t slot_count,
+                       PoolBackend backend)
+        :  cnt_threads_(ValidThreadCount(threads_cnt)),
+        mode_(mode),
+        backend_(backend),
+        queue_capacity_(queue_capacity),
+        running_tasks_(0),
+        shutdown_(false),
+        tasks_slab_(slot_count),
+        tasks_(mode, slot_count),
+        done_waiters_(0),
+        next_inbox_(0),
+        space_waiters_(0),
+        pending_tasks_(0),
+        idle_workers_(0),
+        power_(cnt_threads_),
+        stats_(Stats{1.0, 0, 0.0, 0.0, static_cast<double>(cnt_threads_)}),
+        wait_histogram_(backend == PoolBackend::Threads ? cnt_threads_ + 2 : 1),
+        service_histogram_(backend == PoolBackend::Threads ? cnt_threads_ + 2 : 1),
+        total_histogram_(backend == PoolBackend::Threads ? cnt_threads_ + 2 : 1),
+        avg_task_time_(50),
+        default_deadline_ms_(Config::kLatencyThreshold),
+        drop_expired_(false),
+        expired_tasks_(0),
+        dropped_tasks_(0),
+        outstanding_tasks_(0)
+{
+    if (backend_ == PoolBackend::Simulated)
+    {   // 不创建线程：任务由 _DispatchToCores() 分派到逻辑核心上，统计由模拟器每秒触发一次
+        Simulator::Instance().Every(std::chrono::seconds(1), [this]() {
+            if (shutdown_)
+                return false;
+            _SampleStats();
+            return true;
+        });
+        return;
     }
 
-    worker_threads.emplace_back(std::thread([this](){this->_MonitorRoutine();}));
+    // 每秒的统计注册在全局时间轮上，不再单独占用一个 monitor 线程，JoinAll() 时取消
+    stats_timer_ = TimerWheel::Instance().Every(std::chrono::seconds(1), [this]() { _SampleStats(); });
+
+    if (backend_ == PoolBackend::Executor)
+        return;     // 不创建线程：任务由 _DispatchToCores() 分派到共享执行器的逻辑核心上
+
+    if (mode_ == QueueMode::WorkStealing)
+    {   // 先把所有 worker 的队列建好，再启动线程，worker 之间会互相窃取
+        for (unsigned i = 0; i < cnt_threads_; ++ i)
+            stealing_workers_.emplace_back(std::make_unique<StealingWorker>());
+
+        for (unsigned i = 0; i < cnt_threads_; ++ i)
+        {
+            std::thread t([this, i](){this->_StealingWorkerRoutine(i);});
+            worker_threads.emplace_back(std::move(t));
+        }
+    }
+    else if (mode_ == QueueMode::BoundedRing)
+    {
+        ring_ = std::make_unique<MpmcRing<TaskSlot*>>(queue_capacity);
+
+        for (unsigned i = 0; i < cnt_threads_; ++ i)
+        {
+            std::thread t([this](){this->_RingWorkerRoutine();});
+            worker_threads.emplace_back(std::move(t));
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < cnt_threads_; ++ i)
+        {
+            std::thread t([this](){this->_WorkerRoutine();});
+            worker_threads.emplace_back(std::move(t));
+        }
+    }
 }
 
 ThreadPool::~ThreadPool()
@@ -33,7 +107,8 @@ ThreadPool::~ThreadPool()
 
 double ThreadPool::GetLoad() const
 {
-    return  GetTaskQueueSize() / GetCurrentSpeed(); 
+    Stats stats = stats_.Load();
+    return  stats.queue_size / stats.speed;
 }
 
 
@@ -41,6 +116,19 @@ void ThreadPool::JoinAll()
 {
     decltype(worker_threads) tmp;
 
+    stats_timer_.Cancel();
+
+    if (backend_ == PoolBackend::Executor)
+    {   // 没有自己的线程，等待已提交的任务全部完成即可
+        std::unique_lock<std::mutex> guard(mutex_);
+
+        shutdown_ = true;
+        cond_.wait(guard, [this](){
+            return tasks_.empty() && running_tasks_ == 0;
+        });
+        return;
+    }
+
     {
         std::unique_lock<std::mutex> guard(mutex_);
 
@@ -49,6 +137,7 @@ void ThreadPool::JoinAll()
 
         shutdown_ = true;
         cond_.notify_all();
+        space_cond_.notify_all();
 
         tmp.swap(worker_threads);
     }
@@ -65,7 +154,7 @@ void ThreadPool::_WorkerRoutine()
 {
     while (true)
     {
-        std::function<void ()> task;
+        TaskSlot* slot;
 
         {
             std::unique_lock<std::mutex> guard(mutex_);
@@ -81,152 +170,693 @@ void ThreadPool::_WorkerRoutine()
                 return;
             }
 
-            // 从任务队列移除一个任务的同时，必须同步移除一个 task_enter_time
-            task = std::move(tasks_.front());
-            tasks_.pop_front();
-
-            auto start = task_enter_time_.front();
-            task_enter_time_.pop_front();
-
-            auto time_dur = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start);
-
-            if (time_dur.count() >= avg_task_time_ * 0.8)
-            {   // 如果任务的等待时间超过任务平均耗时的80%，认为该任务阻塞时间过长，标记为 blocked_task
-                blocked_tasks_in_one_second_++;
-            }
+            // 任务的入队时间记录在任务槽中，随任务一起出队
+            slot = tasks_.pop();
         }
 
-        task();
+        if (_AdmitSlot(slot))
+            _ExecuteSlot(slot);
+    }
+}
 
-        tasks_completed_in_one_second_ ++;
+TaskSlot* ThreadPool::_AcquireSlot(bool allow_heap)
+{
+    TaskSlot* slot = tasks_slab_.Acquire();
+
+    if (slot == nullptr && allow_heap)
+    {   // 任务槽耗尽，临时在堆上分配一个，执行完后释放
+        slot = new TaskSlot();
+        slot->pooled = false;
     }
+
+    return slot;
 }
 
-// 每隔一秒计算一下：上一秒处理的任务数量，即速度
-void ThreadPool::_MonitorRoutine()
+bool ThreadPool::_PushSlot(TaskSlot* slot, bool blocking)
 {
-    while (true)
+    // 从进入任务队列起算作未完成的任务；入队失败时由 _CompleteSlot() 减回去
+    outstanding_tasks_.fetch_add(1, std::memory_order_relaxed);
+
+    // 任务入队的同时进行计时，并由入队时间推算截止期限
+    slot->enter_time = _Now();
+    slot->deadline = slot->enter_time + std::chrono::milliseconds(
+            slot->deadline_ms != 0 ? slot->deadline_ms : default_deadline_ms_);
+
+    if (backend_ != PoolBackend::Threads)
+    {
+        if (_PushCoreTask(slot, blocking))
+            return true;
+    }
+    else if (mode_ == QueueMode::WorkStealing)
+    {
+        if (_PushStealingTask(slot))
+            return true;
+    }
+    else if (mode_ == QueueMode::BoundedRing)
     {
-        if (shutdown_ && tasks_.empty())
+        if (_PushRingTask(slot, blocking))
+            return true;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        if (!shutdown_)
         {
-            return;
+            tasks_.push(slot);
+            cond_.notify_one();
+            return true;
         }
+    }
 
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    // 线程池已关闭（worker 可能已经退出）或者队列已满，丢弃这个任务
+    slot->Clear();
+    _CompleteSlot(slot);
+    return false;
+}
 
-        /* 1. CPU 使用率 */
-        loads_.push_back(GetLoad());
-        while (loads_.size() > 3)
-            loads_.pop_front();
+void ThreadPool::_PushSlotBatch(TaskSlotQueue& batch)
+{
+    size_t count = batch.size();
+    auto now = _Now();
 
-        /* 2. 阻塞的任务数量 */
-        blocked_tasks_.push_back(blocked_tasks_in_one_second_);
-        blocked_tasks_in_one_second_ = 0;
-        while (blocked_tasks_.size() > 3)
-            blocked_tasks_.pop_front();
+    outstanding_tasks_.fetch_add(static_cast<long>(count), std::memory_order_relaxed);
 
-        /* 3. 任务处理速度 */
-        if (tasks_completed_in_one_second_ == 0)
+    for (TaskSlot* slot = batch.front(); slot != nullptr; slot = slot->next)
+    {
+        slot->enter_time = now;
+        slot->deadline = now + std::chrono::milliseconds(
+                slot->deadline_ms != 0 ? slot->deadline_ms : default_deadline_ms_);
+    }
+
+    if (backend_ != PoolBackend::Threads)
+    {   // 整批入队，然后让空闲的逻辑核心开始执行
+        bool accepted = false;
         {
-            speeds_.push_back(1);
+            std::lock_guard<std::mutex> guard(mutex_);
+            if (!shutdown_)
+            {
+                tasks_.splice(batch);
+                accepted = true;
+            }
         }
-        else
+
+        if (accepted)
         {
-            speeds_.push_back(tasks_completed_in_one_second_);
-            tasks_completed_in_one_second_ = 0;
+            _DispatchToCores();
+            return;
         }
-        while (speeds_.size() > 3)  // 别用if
-            speeds_.pop_front();
+    }
+    else if (mode_ == QueueMode::BoundedRing)
+    {   // 环形队列本身无锁，逐个入队；队满时和 ExecuteTask() 一样阻塞等待
+        while (!batch.empty())
+        {
+            TaskSlot* slot = batch.pop_front();
+            if (!_PushRingTask(slot, true))
+            {   // 只有线程池关闭时才会失败
+                slot->Clear();
+                _CompleteSlot(slot);
+            }
+        }
+        return;
+    }
+    else if (mode_ == QueueMode::WorkStealing)
+    {   // 整批放进同一个 inbox，只加一次锁；其它 worker 会从这个 inbox 中窃取
+        // 与 _PushStealingTask() 一样，先计入 pending_tasks_ 再检查 shutdown_
+        pending_tasks_.fetch_add(count);
+        if (!shutdown_.load())
+        {
+            unsigned index = next_inbox_.fetch_add(1, std::memory_order_relaxed) % stealing_workers_.size();
+            auto& worker = *stealing_workers_[index];
+            {
+                std::lock_guard<std::mutex> guard(worker.inbox_mutex);
+                worker.inbox.splice(batch);
+            }
 
-        /* 4. 任务队列长度 */
-        if (tasks_.empty())
+            if (idle_workers_.load() > 0)
+            {
+                std::lock_guard<std::mutex> guard(mutex_);
+                cond_.notify_all();
+            }
+            return;
+        }
+
+        pending_tasks_.fetch_sub(count);
+    }
+    else
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        if (!shutdown_)
         {
-            task_queue_size_.push_back(1);
+            tasks_.splice(batch);
+
+            // 任务数量不少于 worker 数量时直接全部唤醒
+            if (count >= worker_threads.size())
+                cond_.notify_all();
+            else
+                for (size_t i = 0; i < count; ++ i)
+                    cond_.notify_one();
+            return;
+        }
+    }
+
+    // 线程池已关闭，丢弃整批任务
+    while (!batch.empty())
+    {
+        TaskSlot* slot = batch.pop_front();
+        slot->Clear();
+        _CompleteSlot(slot);
+    }
+}
+
+void ThreadPool::_ExecuteSlot(TaskSlot* slot)
+{
+    _InvokeSlot(slot);
+
+    tasks_completed_in_one_second_ ++;
+
+    _RecordServiceTime(slot);
+    _CompleteSlot(slot);
+}
+
+void ThreadPool::_InvokeSlot(TaskSlot* slot)
+{
+    try
+    {
+        slot->Run();
+    }
+    catch (const std::exception& e)
+    {   // ExecuteTask() 提交的任务会把异常交给 future，只有 Submit() 提交的任务会走到这里
+        LOG(ERROR) << "ThreadPool: task threw an exception: " << e.what();
+    }
+    catch (...)
+    {
+        LOG(ERROR) << "ThreadPool: task threw an unknown exception";
+    }
+}
+
+bool ThreadPool::_PushCoreTask(TaskSlot* slot, bool blocking)
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        if (shutdown_)
+            return false;
+
+        // 逻辑核心上没有可以阻塞等待的提交方，blocking 的提交即使队满也照常入队
+        if (mode_ == QueueMode::BoundedRing && !blocking && tasks_.size() >= queue_capacity_)
+            return false;
+
+        tasks_.push(slot);
+    }
+
+    _DispatchToCores();
+    return true;
+}
+
+void ThreadPool::_DispatchToCores()
+{
+    std::unique_lock<std::mutex> guard(mutex_);
+
+    while (running_tasks_ < cnt_threads_ && !tasks_.empty())
+    {
+        TaskSlot* slot = tasks_.pop();
+        running_tasks_++;
+
+        guard.unlock();
+
+        if (backend_ == PoolBackend::Simulated)
+        {   // 模拟模式下直接开始执行；被丢弃的任务在这里释放核心，避免递归分派
+            if (!_StartOnCore(slot))
+            {
+                std::lock_guard<std::mutex> release_guard(mutex_);
+                running_tasks_--;
+            }
         }
         else
         {
-            task_queue_size_.push_back(tasks_.size() + 2);
+            Executor::Instance().Post([this, slot]() {
+                if (!_StartOnCore(slot))
+                    _ReleaseCore();
+            });
         }
 
-        while (task_queue_size_.size() > 3) // 别用if
-            task_queue_size_.pop_front();
+        guard.lock();
     }
 }
 
+bool ThreadPool::_StartOnCore(TaskSlot* slot)
+{
+    if (!_AdmitSlot(slot))
+        return false;
 
-double ThreadPool::GetCurrentSpeed() const
+    // 闭包立即执行（只改变 Server 的状态，不会阻塞），任务对核心的占用由 service_ms 之后的完成事件结束
+    // 闭包执行后槽内已经为空，但在完成事件之前不会被回收，TaskHandle 也要到那时才算完成
+    std::chrono::milliseconds service(slot->service_ms);
+    _InvokeSlot(slot);
+
+    auto finish = [this, slot]() {
+        tasks_completed_in_one_second_ ++;
+        _RecordServiceTime(slot);
+        _CompleteSlot(slot);
+        _ReleaseCore();
+    };
+
+    if (backend_ == PoolBackend::Simulated)
+        Simulator::Instance().Schedule(service, finish);
+    else
+        Executor::Instance().ScheduleAfter(service, finish);
+
+    return true;
+}
+
+void ThreadPool::_ReleaseCore()
 {
-    std::deque<unsigned> tmp(speeds_);
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        running_tasks_--;
+
+        // JoinAll() 在 cond_ 上等待所有任务完成
+        if (shutdown_)
+            cond_.notify_all();
+    }
 
-    if (tmp.empty())
-        return 1.0;
+    _DispatchToCores();
+}
+
+MonotonicClock::time_point ThreadPool::_Now() const
+{
+    if (backend_ == PoolBackend::Simulated)
+    {   // 虚拟时间从 0 开始，只用于计算时间差，不会与真实时间混用
+        return MonotonicClock::time_point(std::chrono::nanoseconds(SimulatorNow()));
+    }
+
+    // 单调时钟，系统时间被调整时入队时间、截止期限和耗时统计不会跳变
+    return MonotonicClock::now();
+}
+
+void ThreadPool::_CompleteSlot(TaskSlot* slot)
+{
+    outstanding_tasks_.fetch_sub(1, std::memory_order_relaxed);
+
+    _FinishSlot(slot);
+}
+
+void ThreadPool::_FinishSlot(TaskSlot* slot)
+{
+    TaskSlot* group = slot->group;
+    slot->group = nullptr;
 
-    unsigned sum = std::accumulate(tmp.begin(), tmp.end(), 0.0);
-    double mean = sum / tmp.size();
+    // 版本号加 1 之后，持有旧版本号的 TaskHandle 就能看到任务完成
+    slot->generation.fetch_add(1);
 
-    if (mean < 1)
-    {   // 这个 if 应该永远不成立，因为 speeds_ 中不会有小于 1 的值存在
-        LOG(ERROR) << "Threadpool: speed < 1";
-        return 1.0;
+    // 与 _WaitSlot() 中先增加 done_waiters_ 再检查版本号相对应，不会丢失唤醒
+    if (done_waiters_.load() > 0)
+    {
+        std::lock_guard<std::mutex> guard(done_mutex_);
+        done_cond_.notify_all();
     }
+
+    if (slot->pooled)
+        tasks_slab_.Release(slot);
     else
+        delete slot;
+
+    // 批量任务中的最后一个完成时，聚合槽也随之完成
+    if (group != nullptr && group->remaining.fetch_sub(1) == 1)
+        _FinishSlot(group);
+}
+
+void ThreadPool::_WaitSlot(const TaskSlot* slot, uint32_t generation)
+{
+    done_waiters_.fetch_add(1);
     {
-        return mean;
+        std::unique_lock<std::mutex> guard(done_mutex_);
+        done_cond_.wait(guard, [slot, generation](){
+            return slot->generation.load() != generation;
+        });
     }
+    done_waiters_.fetch_sub(1);
 }
 
-int ThreadPool::GetTaskQueueSize() const
+bool ThreadPool::_AdmitSlot(TaskSlot* slot)
+{
+    auto now = _Now();
+
+    // System 优先级的任务（服务器自身的管理任务）不受截止期限约束
+    if (slot->priority != TaskPriority::System && now > slot->deadline)
+    {
+        expired_tasks_++;
+
+        if (drop_expired_)
+        {   // 执行一个已经错过截止期限的任务只会拖慢后面的任务，直接丢弃；不计入 blocked_task
+            dropped_tasks_++;
+            slot->Clear();
+            _CompleteSlot(slot);
+            return false;
+        }
+    }
+
+    slot->start_time = now;
+    _RecordWaitTime(slot);
+    return true;
+}
+
+void ThreadPool::_RecordWaitTime(const TaskSlot* slot)
 {
-    std::deque<unsigned> tmp(task_queue_size_);
+    auto wait = slot->start_time - slot->enter_time;
 
-    if (tmp.empty())
-        return 0;
+    // 直方图只统计请求的延迟，System 优先级的管理任务（例如常驻的 GC 循环）不计入
+    if (slot->priority != TaskPriority::System)
+        wait_histogram_.Record(ToMicroseconds(wait));
 
-    unsigned sum = std::accumulate(tmp.begin(), tmp.end(), 0.0);
-    double mean = sum / tmp.size();
+    auto time_dur = std::chrono::duration_cast<std::chrono::milliseconds>(wait);
 
-    return mean;
+    if (time_dur.count() >= avg_task_time_ * 0.8)
+    {   // 如果任务的等待时间超过任务平均耗时的80%，认为该任务阻塞时间过长，标记为 blocked_task
+        blocked_tasks_in_one_second_++;
+    }
 }
 
+void ThreadPool::_RecordServiceTime(const TaskSlot* slot)
+{
+    if (slot->priority == TaskPriority::System)
+        return;
 
-double ThreadPool::GetAverageLoad() const
+    auto now = _Now();
+
+    uint64_t total = ToMicroseconds(now - slot->enter_time);
+
+    service_histogram_.Record(ToMicroseconds(now - slot->start_time));
+    total_histogram_.Record(total);
+    latency_ewma_.Observe(static_cast<double>(total), ToMicroseconds(now.time_since_epoch()));
+}
+
+double ThreadPool::GetLatencyEwma() const
+{
+    return latency_ewma_.Get(ToMicroseconds(_Now().time_since_epoch()));
+}
+
+void ThreadPool::SetLatencyDecay(unsigned tau_ms)
+{
+    latency_ewma_.SetTau(tau_ms);
+
+    // 还没有任务完成时，以平均任务耗时作为初始估计，避免所有请求都涌向估计值为 0 的服务器
+    latency_ewma_.Reset(avg_task_time_ * 1000, ToMicroseconds(_Now().time_since_epoch()));
+}
+
+bool ThreadPool::_PushStealingTask(TaskSlot* slot)
 {
-    std::deque<double> tmp(loads_);
+    if (tls_owner_pool == this)
+    {   // worker 线程自己提交的任务（例如 GC 任务）直接压入自己的队列，无需加锁
+        // 提交者自己就是 worker，退出之前一定会取走这个任务，不需要检查 shutdown_
+        stealing_workers_[tls_worker_index]->deque.Push(slot);
+        _SignalPendingTask();
+        return true;
+    }
+
+    // 外部线程提交的任务轮流放进各 worker 的 inbox，只加这个 inbox 的锁
+    // worker 只有在 shutdown_ 且 pending_tasks_ 归零时才退出：先计入 pending_tasks_ 再检查 shutdown_（都是 seq_cst），
+    // 看到 shutdown_ 的提交撤销计数并拒绝任务；没看到的提交，worker 退出前一定能看到它的计数，会继续等它入队并取走
+    pending_tasks_.fetch_add(1);
+    if (shutdown_.load())
+    {
+        pending_tasks_.fetch_sub(1);
+        return false;
+    }
+
+    unsigned index = next_inbox_.fetch_add(1, std::memory_order_relaxed) % stealing_workers_.size();
+    auto& worker = *stealing_workers_[index];
+    {
+        std::lock_guard<std::mutex> guard(worker.inbox_mutex);
+        worker.inbox.push_back(slot);
+    }
 
-    if (tmp.empty())
-        return 0;
+    // 与 _SignalPendingTask() 相同，只有存在休眠的 worker 时才需要进入 mutex_ 去唤醒
+    if (idle_workers_.load() > 0)
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        cond_.notify_one();
+    }
+    return true;
+}
 
-    double sum = std::accumulate(tmp.begin(), tmp.end(), 0.0);
-    double mean = sum / tmp.size();
+void ThreadPool::_SignalPendingTask()
+{
+    pending_tasks_.fetch_add(1);
 
-    return mean;
+    // 只有存在休眠的 worker 时才需要进入 mutex_ 去唤醒
+    // pending_tasks_ 和 idle_workers_ 都是 seq_cst，休眠方先增加 idle_workers_ 再在锁内检查 pending_tasks_，不会丢失唤醒
+    if (idle_workers_.load() > 0)
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        cond_.notify_one();
+    }
 }
 
-double ThreadPool::GetPower()
+bool ThreadPool::_WaitForPendingTask()
 {
-    // 每次调用都会计算新值
-    power_ = 0.37 * power_ + 0.63 * (GetCurrentSpeed() / GetTaskQueueSize());   // 指数移动平均
-    return power_;
+    idle_workers_.fetch_add(1);
+    {
+        std::unique_lock<std::mutex> guard(mutex_);
+        cond_.wait(guard, [this](){
+            return shutdown_ || pending_tasks_.load() > 0;
+        });
+    }
+    idle_workers_.fetch_sub(1);
+
+    // 与 Shared 模式一致：仅当 shutdown_ 为 true 且没有待处理任务时才结束
+    return !(shutdown_ && pending_tasks_.load() <= 0);
 }
 
+TaskSlot* ThreadPool::_TakeStealingTask(unsigned index, uint64_t& rand_state)
+{
+    auto& self = *stealing_workers_[index];
+
+    /* 1. 自己的队列 */
+    TaskSlot* task = self.deque.Pop();
+    if (task != nullptr)
+        return task;
+
+    /* 2. 自己的 inbox，整体搬进自己的队列，之后其它 worker 就可以窃取它们 */
+    {
+        std::lock_guard<std::mutex> guard(self.inbox_mutex);
+        while (!self.inbox.empty())
+            self.deque.Push(self.inbox.pop_front());
+    }
+
+    task = self.deque.Pop();
+    if (task != nullptr)
+        return task;
+
+    /* 3. 从随机的 victim 开始，依次尝试窃取其它 worker 的队列和 inbox */
+    size_t n = stealing_workers_.size();
+
+    rand_state ^= rand_state << 13;     // xorshift64
+    rand_state ^= rand_state >> 7;
+    rand_state ^= rand_state << 17;
 
-double ThreadPool::GetBlockRate()
+    size_t start = rand_state % n;
+    for (size_t i = 0; i < n; ++ i)
+    {
+        size_t victim_index = (start + i) % n;
+        if (victim_index == index)
+            continue;
+
+        auto& victim = *stealing_workers_[victim_index];
+
+        task = victim.deque.Steal();
+        if (task != nullptr)
+            return task;
+
+        // victim 可能正在执行一个耗时任务而来不及处理自己的 inbox
+        std::unique_lock<std::mutex> guard(victim.inbox_mutex, std::try_to_lock);
+        if (guard.owns_lock() && !victim.inbox.empty())
+        {
+            return victim.inbox.pop_front();
+        }
+    }
+
+    return nullptr;
+}
+
+void ThreadPool::_StealingWorkerRoutine(unsigned index)
 {
-    std::deque<unsigned> tmp(blocked_tasks_);
+    tls_owner_pool = this;
+    tls_worker_index = index;
 
-    if (tmp.empty())
-        return 0.01;
+    uint64_t rand_state = reinterpret_cast<uintptr_t>(this) ^ (0x9E3779B97F4A7C15ULL * (index + 1));
 
-    unsigned sum = std::accumulate(tmp.begin(), tmp.end(), 0.0);
-    double mean = sum / tmp.size();
+    while (true)
+    {
+        TaskSlot* slot = _TakeStealingTask(index, rand_state);
 
-    double rate = mean / GetCurrentSpeed();
+        if (slot == nullptr)
+        {
+            if (!_WaitForPendingTask())
+            {   // 退出前再扫一遍各个队列和 inbox：worker 自己提交的任务先入队后计数，计数归零时队列里仍可能有任务
+                slot = _TakeStealingTask(index, rand_state);
+                if (slot == nullptr)
+                    return;
+
+                pending_tasks_.fetch_sub(1);
+                if (_AdmitSlot(slot))
+                    _ExecuteSlot(slot);
+                continue;
+            }
+
+            // 被唤醒不代表一定能取到任务（可能被别的 worker 抢先），重新走一遍获取流程
+            continue;
+        }
+
+        pending_tasks_.fetch_sub(1);
+
+        if (_AdmitSlot(slot))
+            _ExecuteSlot(slot);
+    }
+}
+
+bool ThreadPool::_PushRingTask(TaskSlot* slot, bool blocking)
+{
+    while (!ring_->TryPush(slot))
+    {
+        if (!blocking || shutdown_)
+            return false;
+
+        // 队满，等待 worker 取走任务
+        // 判断队列是否有空位的读取不带全序屏障，这里用带超时的等待兜底，避免偶发的丢失唤醒让提交者一直卡住
+        space_waiters_.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> guard(mutex_);
+            space_cond_.wait_for(guard, std::chrono::milliseconds(1), [this](){
+                return shutdown_ || ring_->Size() < ring_->Capacity();
+            });
+        }
+        space_waiters_.fetch_sub(1);
+    }
+
+    _SignalPendingTask();
+    return true;
+}
+
+void ThreadPool::_RingWorkerRoutine()
+{
+    while (true)
+    {
+        TaskSlot* slot = nullptr;
+
+        if (!ring_->TryPop(slot))
+        {
+            if (!_WaitForPendingTask())
+                return;
+
+            continue;
+        }
+
+        pending_tasks_.fetch_sub(1);
+
+        // 腾出了一个空位，唤醒一个因队满而阻塞的提交者
+        if (space_waiters_.load() > 0)
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            space_cond_.notify_one();
+        }
+
+        if (_AdmitSlot(slot))
+            _ExecuteSlot(slot);
+    }
+}
+
+size_t ThreadPool::_QueuedTaskCount() const
+{
+    if (backend_ == PoolBackend::Threads && mode_ == QueueMode::BoundedRing)
+        return ring_->Size();
+
+    if (backend_ == PoolBackend::Threads && mode_ == QueueMode::WorkStealing)
+    {
+        long pending = pending_tasks_.load(std::memory_order_relaxed);
+        return pending > 0 ? pending : 0;
+    }
+
+    // tasks_ 由 worker 在 mutex_ 内修改，读取它的长度也要加锁
+    std::lock_guard<std::mutex> guard(mutex_);
+    return tasks_.size();
+}
+
+// 每隔一秒计算一下：上一秒处理的任务数量，即速度
+void ThreadPool::_SampleStats()
+{
+    /* 1. CPU 使用率 */
+    loads_.Push(GetLoad());
+
+    /* 2. 阻塞的任务数量 */
+    blocked_tasks_.Push(blocked_tasks_in_one_second_.exchange(0));
+
+    /* 3. 任务处理速度 */
+    unsigned completed = tasks_completed_in_one_second_.exchange(0);
+    speeds_.Push(completed == 0 ? 1 : completed);
+
+    /* 4. 任务队列长度 */
+    size_t queued = _QueuedTaskCount();
+    task_queue_size_.Push(queued == 0 ? 1 : queued + 2);
+
+    /* 5. 算好平均值，整体发布给读者 */
+    Stats stats;
+    stats.speed = speeds_.Mean();
+    stats.queue_size = static_cast<int>(task_queue_size_.Mean());
+    stats.average_load = loads_.Mean();
+    stats.blocked = blocked_tasks_.Mean();
+
+    // speeds_ 中不会有小于 1 的值存在，queue_size 也至少为 1
+    power_ = 0.37 * power_ + 0.63 * (stats.speed / stats.queue_size);   // 指数移动平均
+    stats.power = power_;
+
+    stats_.Store(stats);
+}
+
+
+double ThreadPool::GetCurrentSpeed() const
+{
+    return stats_.Load().speed;
+}
+
+size_t ThreadPool::GetTaskQueueDepth() const
+{
+    return _QueuedTaskCount();
+}
+
+int ThreadPool::GetTaskQueueSize() const
+{
+    return stats_.Load().queue_size;
+}
+
+
+double ThreadPool::GetAverageLoad() const
+{
+    return stats_.Load().average_load;
+}
+
+double ThreadPool::GetPower() const
+{
+    return stats_.Load().power;
+}
+
+
+double ThreadPool::GetBlockRate() const
+{
+    Stats stats = stats_.Load();
+
+    double rate = stats.blocked / stats.speed;
 
     return rate < 0.01 ? 0.01 : rate;
 }
 
 unsigned ThreadPool::GetThreadCount()
 {
+    if (backend_ != PoolBackend::Threads)
+        return cnt_threads_;
+
     return worker_threads.size();
 }
 
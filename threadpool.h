@@ -8,19 +8,98 @@
 #include <future>
 #include <queue>
 #include <ctime>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <condition_variable>
 
 #include <glog/logging.h>
 
+#include "config.h"
+#include "latency_histogram.h"
+#include "mpmc_ring.h"
+#include "peak_ewma.h"
+#include "seqlock.h"
+#include "sliding_window.h"
+#include "task_queue.h"
+#include "task_slot.h"
+#include "timer_wheel.h"
+#include "work_stealing_deque.h"
+
 /*
 * 线程池
 * 用来模拟CPU，线程数量固定不可扩展，因为每一个线程代表一个CPU核心
 * ExecuteTask() 函数用来接受一个任务，任务类型为一个可执行对象
+*
+* 任务队列有两种组织方式（见 QueueMode）：
+* Shared 模式下所有 worker 共用 tasks_，由 mutex_ 保护；
+* WorkStealing 模式下每个 worker 拥有一个 Chase-Lev 双端队列，外部提交的任务轮流投递到各 worker 的 inbox，
+* worker 优先处理自己的任务，空闲时随机窃取其它 worker 的任务，mutex_/cond_ 只用于空闲 worker 的休眠和唤醒；
+* BoundedRing 模式下任务放在有界的无锁环形队列中，队满时 ExecuteTask() 阻塞等待，TryExecuteTask()/Submit() 立即失败；
+* Priority/Deadline 模式与 Shared 一样由 mutex_ 保护，但按优先级或截止期限（EDF）决定执行顺序
+*
+* 每个任务都带有由入队时间推算的截止期限，worker 取出任务时若已超过截止期限，记为 expired，
+* 并可选择直接丢弃（不计入 blocked_tasks_in_one_second_）
+*
+* 每个任务占用一个 TaskSlot，槽从预分配的 slab_ 中取得；Submit() 提交的任务全程不做堆分配，
+* 返回的 TaskHandle 直接由任务槽支撑
+*
+* 统计数据（速度、队列长度、使用率、阻塞数量）由全局时间轮（Simulated 模式下为模拟器）每秒采样一次，保存在定长的滑动窗口中并维护滑动和，
+* 采样后把算好的平均值通过 SeqLock 整体发布；各个 Get 接口只读取这份快照，O(1)、无锁、无内存分配
+*
+* 每个任务的排队等待时间、执行时间和总耗时（入队到完成）记录在三个延迟直方图中，单位 us，可按分位数查询；
+* 总耗时同时计入一个 Peak-EWMA 估计值，供延迟感知的负载均衡使用；System 优先级的管理任务都不计入
+*
+* PoolBackend::Simulated/Executor 下不创建任何线程，cnt_threads_ 个核心只是逻辑容量：只要有空闲核心就从 tasks_ 中取任务，
+* 闭包在任务开始时立即执行（不能阻塞），任务再占用核心 service_ms 之后由定时事件结束，释放核心。
+* Simulated 在离散事件模拟器的虚拟时钟上执行，截止期限、等待时间和每秒的统计都基于虚拟时钟，不能调用 TaskHandle::Wait()；
+* Executor 把闭包和定时事件交给进程级共享执行器，大量线程池共用 hardware_concurrency() 个线程。
+* 这两种方式下所有队列模式都退化为加锁的 tasks_（WorkStealing/BoundedRing 为 FIFO，
+* BoundedRing 仍按 queue_capacity 拒绝 TryExecuteTask()/Submit()）
 */
 
+class ThreadPool;
+
+/*
+ * 任务完成句柄
+ * 轻量级的“future”：只记录任务槽和提交时槽的版本号，槽的版本号变化即说明任务已完成
+ * 句柄本身可以随意拷贝，不持有任何资源；等待时线程池必须仍然存活
+ */
+class TaskHandle
+{
+public:
+    TaskHandle() : pool_(nullptr), slot_(nullptr), generation_(0) {}
+
+    /* 是否对应一个已提交的任务 */
+    bool Valid() const { return slot_ != nullptr; }
+
+    /* 任务是否已经完成（无效句柄视为已完成） */
+    bool Done() const
+    {
+        return slot_ == nullptr || slot_->generation.load(std::memory_order_acquire) != generation_;
+    }
+
+    /* 阻塞直到任务完成 */
+    void Wait() const;
+
+private:
+    friend class ThreadPool;
+
+    TaskHandle(ThreadPool* pool, TaskSlot* slot, uint32_t generation)
+        : pool_(pool), slot_(slot), generation_(generation) {}
+
+    ThreadPool* pool_;
+    TaskSlot*   slot_;
+    uint32_t    generation_;
+};
+
 class ThreadPool
 {
 public:
-    explicit ThreadPool(unsigned thread_count);
+    explicit ThreadPool(unsigned thread_count, QueueMode mode = QueueMode::Shared,
+                        size_t queue_capacity = Config::kDefaultQueueCapacity,
+                        size_t slot_count = Config::kTaskSlotCount,
+                        PoolBackend backend = PoolBackend::Threads);
     ~ThreadPool();
 
     ThreadPool() = delete;
@@ -40,25 +119,65 @@ public:
     double  GetAverageLoad() const;
 
     /* get 算力 */
-    double  GetPower();
+    double  GetPower() const;
 
 
     /* 等待所有线程结束，然后关闭线程池 */
     void JoinAll();
 
-    /* 向线程池中添加一个任务 */
+    /* 向线程池中添加一个任务，BoundedRing 模式下队满时阻塞等待 */
     template<typename F, typename... Args>
     auto ExecuteTask(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F (Args...)>::type>;
 
+    /* 向线程池中添加一个任务，BoundedRing 模式下队满时立即失败，返回无效的 future（valid() 为 false） */
+    template<typename F, typename... Args>
+    auto TryExecuteTask(F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F (Args...)>::type>;
+
+    /* 同 ExecuteTask()，并指定优先级和截止期限 */
+    template<typename F, typename... Args>
+    auto ExecuteTaskWithOptions(const TaskOptions& options, F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F (Args...)>::type>;
+
+    /* 同 TryExecuteTask()，并指定优先级和截止期限 */
+    template<typename F, typename... Args>
+    auto TryExecuteTaskWithOptions(const TaskOptions& options, F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F (Args...)>::type>;
+
+    /*
+     * 向线程池中添加一个任务，不做任何堆分配
+     * 任务槽耗尽、队列已满或线程池已关闭时返回无效的 TaskHandle，任务不会被执行
+     */
+    template<typename F>
+    TaskHandle Submit(F&& f);
+
+    /* 同 Submit()，并指定优先级和截止期限 */
+    template<typename F>
+    TaskHandle Submit(const TaskOptions& options, F&& f);
+
+    /*
+     * 批量添加任务：为 [first, last) 中的每个元素提交一个任务 f(*it)
+     * 所有任务只加一次锁入队，并一次性唤醒足够多的 worker；BoundedRing 模式下队满时阻塞等待
+     * @return 聚合的完成句柄，所有任务完成后才算完成；任务槽耗尽时任务照常执行，但返回无效句柄
+     */
+    template<typename Iterator, typename F>
+    TaskHandle ExecuteBatch(Iterator first, Iterator last, F f, const TaskOptions& options = TaskOptions());
+
     /* get 最近三个周期内的处理速度平均值 */
     double GetCurrentSpeed() const;
 
     /* get 最近三个周期内的等待队列平均长度 */
     int GetTaskQueueSize() const;
 
+    /* get 当前等待队列的实际长度 */
+    size_t GetTaskQueueDepth() const;
+
     /* get 阻塞率（平均值） */
-    double GetBlockRate();
+    double GetBlockRate() const;
+
+    /* get 当前未完成（排队中和执行中）的任务数量，精确值，任务入队和结束时立即更新 */
+    long GetOutstandingTaskCount() const { return outstanding_tasks_.load(std::memory_order_relaxed); }
 
     /* get 线程数量 */
     unsigned GetThreadCount();
@@ -66,37 +185,212 @@ public:
     /* set 平均任务耗时 */
     void SetAvgTaskTime(double t);
 
+    /* get 平均任务耗时，单位 ms */
+    double GetAvgTaskTime() const { return avg_task_time_; }
+
+    /* set 任务的默认截止期限（相对入队时间），单位 ms */
+    void SetDefaultDeadline(unsigned ms) { default_deadline_ms_ = ms; }
+
+    /* set 是否在执行前丢弃已经超过截止期限的任务 */
+    void SetDropExpired(bool drop) { drop_expired_ = drop; }
+
+    /* get 取出时已经超过截止期限的任务总数（包括被丢弃的） */
+    unsigned GetExpiredTaskCount() const { return expired_tasks_; }
+
+    /* get 因超过截止期限而被丢弃的任务总数 */
+    unsigned GetDroppedTaskCount() const { return dropped_tasks_; }
+
+    /* get 任务排队等待时间、执行时间、总耗时的直方图，单位 us，自线程池创建起累计 */
+    LatencyHistogram::Snapshot GetQueueWaitHistogram() const   { return wait_histogram_.Collect(); }
+    LatencyHistogram::Snapshot GetServiceTimeHistogram() const { return service_histogram_.Collect(); }
+    LatencyHistogram::Snapshot GetTotalTimeHistogram() const   { return total_histogram_.Collect(); }
+
+    /* get 任务总耗时（入队到完成）的 Peak-EWMA 估计值，单位 us，已按距最近一次完成的时间衰减；无锁 */
+    double GetLatencyEwma() const;
+
+    /* set Peak-EWMA 的衰减时间常数，单位 ms；估计值重置为当前的平均任务耗时 */
+    void SetLatencyDecay(unsigned tau_ms);
+
+    /* get 是否既没有排队的任务，也没有执行中的任务（仅 Simulated/Executor 模式下统计执行中的任务） */
+    bool IsIdle() const { return _QueuedTaskCount() == 0 && running_tasks_ == 0; }
+
 private:
+    friend class TaskHandle;
+
+    /* WorkStealing 模式下每个 worker 私有的队列 */
+    struct StealingWorker
+    {
+        WorkStealingDeque<TaskSlot*>    deque;      // 只有本 worker 压入和弹出，其它 worker 从顶部窃取
+        std::mutex                      inbox_mutex;
+        TaskSlotQueue                   inbox;      // 非 worker 线程提交的任务先放在这里
+    };
+
+    /* 取一个任务槽；slab_ 耗尽时，allow_heap 为 true 则临时在堆上分配，否则返回 nullptr */
+    TaskSlot* _AcquireSlot(bool allow_heap);
+
+    /* ExecuteTask() 和 TryExecuteTask() 的实现 */
+    template<typename F, typename... Args>
+    auto _ExecuteTask(bool blocking, const TaskOptions& options, F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F (Args...)>::type>;
+
+    /*
+     * 记录入队时间并把任务槽放进任务队列
+     * 线程池已关闭，或者 blocking 为 false 且队列已满时，丢弃任务并返回 false
+     */
+    bool _PushSlot(TaskSlot* slot, bool blocking = true);
+
+    /* 批量入队，队列中的任务共享同一个入队时间；线程池已关闭时丢弃全部任务 */
+    void _PushSlotBatch(TaskSlotQueue& batch);
+
+    /* 执行任务槽中的任务，然后标记完成并回收任务槽 */
+    void _ExecuteSlot(TaskSlot* slot);
+
+    /* 执行任务槽中的闭包并捕获异常，不标记完成 */
+    void _InvokeSlot(TaskSlot* slot);
+
+    /* 标记任务结束（执行完毕或被丢弃），减少未完成的任务数量，然后 _FinishSlot() */
+    void _CompleteSlot(TaskSlot* slot);
+
+    /* 唤醒等待 slot 的 TaskHandle，并回收任务槽；批量任务全部结束时聚合槽也经由这里完成 */
+    void _FinishSlot(TaskSlot* slot);
+
+    /* 阻塞直到 slot 的版本号不再是 generation */
+    void _WaitSlot(const TaskSlot* slot, uint32_t generation);
+
     /* worker 线程函数 */
     void _WorkerRoutine();
 
-    /* monitor 线程函数 */
-    void _MonitorRoutine();
+    /* WorkStealing 模式下的 worker 线程函数 */
+    void _StealingWorkerRoutine(unsigned index);
+
+    /* WorkStealing 模式下提交一个任务，线程池已关闭时返回 false */
+    bool _PushStealingTask(TaskSlot* slot);
+
+    /* WorkStealing 模式下获取一个任务：自己的队列 -> 自己的 inbox -> 随机窃取 */
+    TaskSlot* _TakeStealingTask(unsigned index, uint64_t& rand_state);
+
+    /* BoundedRing 模式下的 worker 线程函数 */
+    void _RingWorkerRoutine();
+
+    /* BoundedRing 模式下提交一个任务，队满时根据 blocking 决定等待还是返回 false */
+    bool _PushRingTask(TaskSlot* slot, bool blocking);
+
+    /* WorkStealing/BoundedRing 模式：记录一个新提交的任务，必要时唤醒一个休眠的 worker */
+    void _SignalPendingTask();
+
+    /* WorkStealing/BoundedRing 模式：没有任务可做时休眠，线程池关闭且没有待处理任务时返回 false */
+    bool _WaitForPendingTask();
+
+    /*
+     * worker 取出任务后、执行之前调用：检查截止期限并统计等待时间
+     * 任务已过期且 drop_expired_ 为 true 时丢弃任务并返回 false
+     */
+    bool _AdmitSlot(TaskSlot* slot);
+
+    /* 统计任务等待时间（入队到开始执行），等待过长的任务记为 blocked_task */
+    void _RecordWaitTime(const TaskSlot* slot);
+
+    /* 任务执行完毕时统计执行时间和总耗时，并把总耗时计入 latency_ewma_ */
+    void _RecordServiceTime(const TaskSlot* slot);
+
+    /* Simulated/Executor 模式：把任务放进 tasks_ 并尝试开始执行，BoundedRing 模式下队满且 blocking 为 false 时返回 false */
+    bool _PushCoreTask(TaskSlot* slot, bool blocking);
+
+    /* Simulated/Executor 模式：只要有空闲的逻辑核心就从 tasks_ 中取任务开始执行 */
+    void _DispatchToCores();
+
+    /*
+     * Simulated/Executor 模式：在一个已占用的核心上开始执行任务，并在 service_ms 之后触发完成事件
+     * 任务因过期被丢弃时返回 false，此时核心没有被释放，由调用方处理
+     */
+    bool _StartOnCore(TaskSlot* slot);
+
+    /* Simulated/Executor 模式：释放一个核心，并继续分派排队的任务 */
+    void _ReleaseCore();
+
+    /* 当前时间，时间源见 g_config.Clock；Simulated 模式下为虚拟时间 */
+    MonotonicClock::time_point _Now() const;
+
+    /* 当前排队中的任务数量 */
+    size_t _QueuedTaskCount() const;
+
+    /* 计算一次上一秒的各项统计，由时间轮或模拟器每秒调用一次 */
+    void _SampleStats();
 
 
 private:
     unsigned                cnt_threads_;
     std::deque<std::thread> worker_threads;             // 线程池中的线程
+    QueueMode               mode_;                      // 任务队列的组织方式
+    PoolBackend             backend_;                   // 执行方式
+    size_t                  queue_capacity_;            // BoundedRing 模式下任务队列的容量
+    std::atomic<unsigned>   running_tasks_;             // Simulated/Executor 模式下正在占用逻辑核心的任务数量，在 mutex_ 内修改
 
 
-    std::mutex              mutex_;
+    mutable std::mutex      mutex_;
     std::condition_variable cond_;
-    bool                    shutdown_;
+    std::atomic<bool>       shutdown_;          // 提交任务时不加锁读取，写入时持有 mutex_
+
+    TaskSlab                tasks_slab_;        // 预分配的任务槽
+    TaskQueue               tasks_;             // 任务队列（Shared/Priority/Deadline 模式），任务的入队时间记录在各自的任务槽中
 
-    /* 以下两个队列要同时操作进出 */
-    std::deque<std::function<void ()>>  tasks_; // 任务队列
-    std::deque<std::chrono::system_clock::time_point>     task_enter_time_;   // 每一个任务的入队时间
+    /* 等待 TaskHandle 完成的线程在 done_cond_ 上休眠 */
+    std::mutex              done_mutex_;
+    std::condition_variable done_cond_;
+    std::atomic<unsigned>   done_waiters_;
+
+    /* WorkStealing 模式专用 */
+    std::vector<std::unique_ptr<StealingWorker>>    stealing_workers_;
+    std::atomic<unsigned>   next_inbox_;            // 外部提交任务时轮流选择 inbox
+
+    /* BoundedRing 模式专用 */
+    std::unique_ptr<MpmcRing<TaskSlot*>>    ring_;
+    std::condition_variable space_cond_;            // 队满时阻塞的提交者在这里等待，与 mutex_ 配合使用
+    std::atomic<unsigned>   space_waiters_;         // 正在等待队列空位的提交者数量
+
+    /* WorkStealing/BoundedRing 模式 */
+    std::atomic<long>       pending_tasks_;         // 已提交但还未被取走的任务数量（出队可能先于计数，短暂为负）
+    std::atomic<unsigned>   idle_workers_;          // 正在 cond_ 上休眠的 worker 数量
 
     std::atomic<unsigned>   tasks_completed_in_one_second_;     // 1秒内完成的任务数量，每秒清除一次
     std::atomic<unsigned>   blocked_tasks_in_one_second_;       // 没有在规定时间内完成的任务数量，每秒清除一次
-    std::deque<unsigned>    blocked_tasks_;     // 最近3次的阻塞任务数量
-    std::deque<unsigned>    speeds_;            // 最近3次的任务处理速度
-    std::deque<unsigned>    task_queue_size_;   // 最近3次的队列长度
-    std::deque<double>      loads_;             // 最近3次的线程池使用率
 
-    double                  power_;             // 算力，初始值为线程池中的线程数量
+    /* 以下滑动窗口和 power_ 只有 _SampleStats() 读写 */
+    SlidingWindow<unsigned, Config::kStatsWindowSize>   blocked_tasks_;     // 最近3次的阻塞任务数量
+    SlidingWindow<unsigned, Config::kStatsWindowSize>   speeds_;            // 最近3次的任务处理速度
+    SlidingWindow<unsigned, Config::kStatsWindowSize>   task_queue_size_;   // 最近3次的队列长度
+    SlidingWindow<double, Config::kStatsWindowSize>     loads_;             // 最近3次的线程池使用率
+
+    double                  power_;             // 算力，初始值为线程池中的线程数量，每次采样后按指数移动平均更新
+
+    /* 每次采样后发布的统计快照 */
+    struct Stats
+    {
+        double  speed;          // 平均处理速度，窗口为空时为 1
+        int     queue_size;     // 平均队列长度（取整）
+        double  average_load;   // 平均使用率
+        double  blocked;        // 平均阻塞任务数量
+        double  power;
+    };
+    SeqLock<Stats>          stats_;
+    TimerHandle             stats_timer_;       // 每秒采样的定时器，Simulated 模式下不使用
+
+    /* 延迟直方图，每个 worker 线程写自己的分片 */
+    LatencyHistogram        wait_histogram_;
+    LatencyHistogram        service_histogram_;
+    LatencyHistogram        total_histogram_;
+
+    PeakEwma                latency_ewma_;      // 任务总耗时的 Peak-EWMA，单位 us，时间戳使用 _Now()
 
     double                  avg_task_time_;     // 平均任务耗时，由 Server 调用 SetAvgTaskTime(double) 接口进行设置，初始为50
+
+    unsigned                default_deadline_ms_;   // 任务的默认截止期限，初始为 Config::kLatencyThreshold
+    bool                    drop_expired_;          // 是否丢弃已经超过截止期限的任务，默认 false
+    std::atomic<unsigned>   expired_tasks_;         // 取出时已经超过截止期限的任务总数
+    std::atomic<unsigned>   dropped_tasks_;         // 因超过截止期限而被丢弃的任务总数
+
+    /* 未完成的任务数量，负载均衡器在每次选择时都会读取，独占一个缓存行 */
+    alignas(64) std::atomic<long>   outstanding_tasks_;
     
 };
 
@@ -104,39 +398,139 @@ template<typename F, typename... Args>
 auto ThreadPool::ExecuteTask(F &&f, Args&&... args)
             -> std::future<typename std::result_of<F (Args...)>::type>
 {
-    using result_type = typename std::result_of<F (Args...)>::type;
+    return _ExecuteTask(true, TaskOptions(), std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<typename F, typename... Args>
+auto ThreadPool::TryExecuteTask(F &&f, Args&&... args)
+            -> std::future<typename std::result_of<F (Args...)>::type>
+{
+    return _ExecuteTask(false, TaskOptions(), std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<typename F, typename... Args>
+auto ThreadPool::ExecuteTaskWithOptions(const TaskOptions& options, F &&f, Args&&... args)
+            -> std::future<typename std::result_of<F (Args...)>::type>
+{
+    return _ExecuteTask(true, options, std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+template<typename F, typename... Args>
+auto ThreadPool::TryExecuteTaskWithOptions(const TaskOptions& options, F &&f, Args&&... args)
+            -> std::future<typename std::result_of<F (Args...)>::type>
+{
+    return _ExecuteTask(false, options, std::forward<F>(f), std::forward<Args>(args)...);
+}
 
-    std::unique_lock<std::mutex> guard(mutex_);
+template<typename F, typename... Args>
+auto ThreadPool::_ExecuteTask(bool blocking, const TaskOptions& options, F &&f, Args&&... args)
+            -> std::future<typename std::result_of<F (Args...)>::type>
+{
+    using result_type = typename std::result_of<F (Args...)>::type;
 
     if (shutdown_)
         return std::future<result_type>();
 
-    auto promise = std::make_shared<std::promise<result_type>>();
+    // 闭包只存放在任务槽里，不再需要 std::function，promise 可以直接移动进去
+    std::promise<result_type> promise;
 
-    auto future = promise->get_future();
+    auto future = promise.get_future();
 
     auto func = std::bind(std::forward<F>(f), std::forward<Args>(args)...);
-    auto task = [t = std::move(func), pm = promise]() mutable {
+    auto task = [t = std::move(func), pm = std::move(promise)]() mutable {
         try {
             if constexpr (std::is_same<void, result_type>::value) {
                 t();
-                pm->set_value();
+                pm.set_value();
             } else {
-                pm->set_value(t());
+                pm.set_value(t());
             }
         } catch (...) {
-            pm->set_exception(std::current_exception());
+            pm.set_exception(std::current_exception());
         }
     };
 
-    // 任务入队的同时进行计时
-    task_enter_time_.emplace_back(std::chrono::system_clock::now());
-    tasks_.emplace_back(std::move(task));
-//    LOG(INFO) << "ThreadPool task size: " << tasks_.size();
+    TaskSlot* slot = _AcquireSlot(true);
+    slot->Emplace(std::move(task));
+    slot->priority = options.priority;
+    slot->deadline_ms = options.deadline_ms;
+    slot->service_ms = options.service_ms;
 
-    cond_.notify_one();
+    if (!_PushSlot(slot, blocking))
+        return std::future<result_type>();
 
     return future;
 }
 
+template<typename F>
+TaskHandle ThreadPool::Submit(F&& f)
+{
+    return Submit(TaskOptions(), std::forward<F>(f));
+}
+
+template<typename F>
+TaskHandle ThreadPool::Submit(const TaskOptions& options, F&& f)
+{
+    if (shutdown_)
+        return TaskHandle();
+
+    TaskSlot* slot = _AcquireSlot(false);
+    if (slot == nullptr)
+        return TaskHandle();
+
+    // 必须在入队之前读取版本号，入队后任务随时可能完成
+    uint32_t generation = slot->generation.load(std::memory_order_relaxed);
+    slot->Emplace(std::forward<F>(f));
+    slot->priority = options.priority;
+    slot->deadline_ms = options.deadline_ms;
+    slot->service_ms = options.service_ms;
+
+    if (!_PushSlot(slot, false))
+        return TaskHandle();
+
+    return TaskHandle(this, slot, generation);
+}
+
+template<typename Iterator, typename F>
+TaskHandle ThreadPool::ExecuteBatch(Iterator first, Iterator last, F f, const TaskOptions& options)
+{
+    if (shutdown_ || first == last)
+        return TaskHandle();
+
+    // 聚合槽只用来计数，不执行任务；必须来自 slab，句柄才能安全地引用它
+    TaskSlot* group = _AcquireSlot(false);
+    uint32_t generation = 0;
+    TaskSlotQueue batch;
+
+    for (Iterator it = first; it != last; ++ it)
+    {
+        TaskSlot* slot = _AcquireSlot(true);
+        slot->Emplace([f, item = *it]() mutable { f(item); });
+        slot->priority = options.priority;
+        slot->deadline_ms = options.deadline_ms;
+        slot->service_ms = options.service_ms;
+        slot->group = group;
+        batch.push_back(slot);
+    }
+
+    if (group != nullptr)
+    {
+        generation = group->generation.load(std::memory_order_relaxed);
+        group->remaining.store(static_cast<uint32_t>(batch.size()), std::memory_order_relaxed);
+    }
+
+    _PushSlotBatch(batch);
+
+    if (group == nullptr)
+        return TaskHandle();
+
+    return TaskHandle(this, group, generation);
+}
+
+inline void TaskHandle::Wait() const
+{
+    if (!Done())
+        pool_->_WaitSlot(slot_, generation_);
+}
+
 #endif //SEAHI_THREADPOOL_H
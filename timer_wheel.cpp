@@ -0,0 +1,201 @@
+#include "timer_wheel.h"
+
+/* 当前线程是否是时间轮线程 */
+static thread_local bool tls_in_timer_wheel = false;
+
+constexpr std::chrono::milliseconds TimerWheel::kTick;
+
+TimerWheel::TimerWheel()
+    : current_tick_(0), count_(0), start_(std::chrono::steady_clock::now()), shutdown_(false), fired_count_(0)
+{
+    thread_ = std::thread([this]() { ThreadFunc_(); });
+}
+
+TimerWheel::~TimerWheel()
+{
+    Shutdown();
+}
+
+TimerWheel& TimerWheel::Instance()
+{
+    static TimerWheel w;
+    return w;
+}
+
+bool TimerWheel::InTimerThread()
+{
+    return tls_in_timer_wheel;
+}
+
+TimerHandle TimerWheel::Schedule(std::chrono::nanoseconds delay, Callback cb)
+{
+    return Add_(delay, std::chrono::nanoseconds(0), std::move(cb));
+}
+
+TimerHandle TimerWheel::Every(std::chrono::nanoseconds period, Callback cb)
+{
+    return Add_(period, period, std::move(cb));
+}
+
+TimerHandle TimerWheel::Add_(std::chrono::nanoseconds delay, std::chrono::nanoseconds period, Callback cb)
+{
+    auto entry = std::make_shared<TimerEntry>();
+    entry->cb = std::move(cb);
+    entry->period = 0;
+    entry->cancelled.store(false, std::memory_order_relaxed);
+
+    if (period.count() > 0)
+    {   // 周期向上取整到 tick，至少为 1
+        entry->period = (period + kTick - std::chrono::nanoseconds(1)) / kTick;
+        if (entry->period == 0)
+            entry->period = 1;
+    }
+
+    bool was_empty;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        if (shutdown_)
+            return TimerHandle();
+
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        uint64_t now = elapsed / kTick;
+        was_empty = count_ == 0;
+        if (was_empty && now > current_tick_)
+        {   // 时间轮为空时线程不按 tick 醒来，直接把 current_tick_ 拨到当前时间，不需要逐个 tick 追赶
+            current_tick_ = now;
+        }
+
+        // 到期时间向上取整到 tick，保证不会早于 delay 触发，并且至少在下一个 tick
+        auto deadline = elapsed + std::max(delay, std::chrono::nanoseconds(0));
+        entry->expire = std::max<uint64_t>((deadline + kTick - std::chrono::nanoseconds(1)) / kTick, current_tick_ + 1);
+
+        Insert_(entry);
+    }
+
+    // 时间轮原来为空时线程在无限期等待，需要唤醒；否则它每个 tick 都会醒来
+    if (was_empty)
+        cond_.notify_one();
+
+    return TimerHandle(entry);
+}
+
+void TimerWheel::Insert_(std::shared_ptr<TimerEntry> entry)
+{
+    uint64_t delta = entry->expire - current_tick_;
+
+    unsigned level = 0;
+    while (level + 1 < kLevels && delta >= (uint64_t(1) << (kSlotBits * (level + 1))))
+        ++ level;
+
+    if (level == kLevels - 1 && delta >= (uint64_t(1) << (kSlotBits * kLevels)))
+    {   // 超出时间轮的范围（约 49 天），按最远的到期时间处理
+        entry->expire = current_tick_ + (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+    }
+
+    unsigned slot = (entry->expire >> (kSlotBits * level)) & (kSlots - 1);
+    wheel_[level][slot].emplace_back(std::move(entry));
+    ++ count_;
+}
+
+void TimerWheel::Tick_(std::vector<std::shared_ptr<TimerEntry>>& due)
+{
+    ++ current_tick_;
+
+    // 低层每转完一圈，把高一层对应槽中的定时器下放
+    for (unsigned level = 1; level < kLevels; ++ level)
+    {
+        if ((current_tick_ & ((uint64_t(1) << (kSlotBits * level)) - 1)) != 0)
+            break;
+
+        unsigned slot = (current_tick_ >> (kSlotBits * level)) & (kSlots - 1);
+        std::vector<std::shared_ptr<TimerEntry>> entries;
+        entries.swap(wheel_[level][slot]);
+        count_ -= entries.size();
+
+        for (auto& entry : entries)
+            Insert_(std::move(entry));
+    }
+
+    auto& slot = wheel_[0][current_tick_ & (kSlots - 1)];
+    for (auto& entry : slot)
+        due.emplace_back(std::move(entry));
+    count_ -= slot.size();
+    slot.clear();
+}
+
+uint64_t TimerWheel::NowTick_() const
+{
+    return (std::chrono::steady_clock::now() - start_) / kTick;
+}
+
+void TimerWheel::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+
+        if (shutdown_)
+            return;
+        shutdown_ = true;
+    }
+
+    cond_.notify_all();
+
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void TimerWheel::ThreadFunc_()
+{
+    tls_in_timer_wheel = true;
+
+    std::vector<std::shared_ptr<TimerEntry>> due;
+    std::unique_lock<std::mutex> guard(mutex_);
+
+    while (!shutdown_)
+    {
+        if (count_ == 0)
+        {
+            cond_.wait(guard);
+            continue;
+        }
+
+        auto next = start_ + (current_tick_ + 1) * kTick;
+        if (std::chrono::steady_clock::now() < next)
+        {
+            cond_.wait_until(guard, next);
+            continue;
+        }
+
+        // 线程被回调拖慢时一次追上所有落后的 tick，到期时间不会漂移
+        uint64_t now = NowTick_();
+        while (current_tick_ < now && count_ > 0)
+            Tick_(due);
+        if (count_ == 0)
+            current_tick_ = now;
+
+        guard.unlock();
+
+        for (auto& entry : due)
+        {
+            if (entry->cancelled.load(std::memory_order_relaxed))
+                continue;
+
+            entry->cb();
+            fired_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        guard.lock();
+
+        // 周期性的定时器按原来的节拍重新注册；落后太多时从下一个 tick 开始
+        for (auto& entry : due)
+        {
+            if (entry->period == 0 || entry->cancelled.load(std::memory_order_relaxed))
+                continue;
+
+            entry->expire = std::max(entry->expire + entry->period, current_tick_ + 1);
+            Insert_(std::move(entry));
+        }
+        due.clear();
+    }
+}
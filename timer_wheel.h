@@ -0,0 +1,119 @@
+#ifndef TINYEDGEPLAYER_TIMER_WHEEL_H
+#define TINYEDGEPLAYER_TIMER_WHEEL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* 定时器的内部状态，由 TimerWheel 和 TimerHandle 共享 */
+struct TimerEntry
+{
+    std::function<void ()>  cb;
+    uint64_t                expire;     // 到期的 tick
+    uint64_t                period;     // 周期，单位 tick；0 表示只执行一次
+    std::atomic<bool>       cancelled;
+};
+
+/*
+ * 定时器句柄，可以随意拷贝
+ * 取消后回调不会再被执行（取消时正在执行的那一次除外）
+ */
+class TimerHandle
+{
+public:
+    TimerHandle() = default;
+
+    /* 是否对应一个已注册的定时器 */
+    bool Valid() const { return entry_ != nullptr; }
+
+    void Cancel()
+    {
+        if (entry_ != nullptr)
+            entry_->cancelled.store(true, std::memory_order_relaxed);
+    }
+
+private:
+    friend class TimerWheel;
+
+    explicit TimerHandle(std::shared_ptr<TimerEntry> entry) : entry_(std::move(entry)) {}
+
+    std::shared_ptr<TimerEntry> entry_;
+};
+
+/*
+ * 分层时间轮（Varghese & Lauck, "Hashed and Hierarchical Timing Wheels", SOSP'87）
+ * 进程内所有周期性的例行工作（线程池统计、GC、Monitor 采样、负载均衡器刷新等）以及共享执行器的定时事件都注册在这里，
+ * 由同一个线程执行，线程数量和调度抖动都不随服务器数量增长
+ *
+ * tick 为 1ms，共 4 层，每层 256 个槽：第 0 层覆盖 256ms，每往上一层范围扩大 256 倍；
+ * 注册和取消都是 O(1)，高层槽中的定时器在低层转完一圈时被下放（cascade）到低一层
+ *
+ * 回调在时间轮线程中执行，不能阻塞，耗时的工作应该投递到别的线程
+ */
+class TimerWheel
+{
+public:
+    using Callback = std::function<void ()>;
+
+    static TimerWheel& Instance();  // 单例模式，第一次调用时启动线程
+
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel&) = delete;
+    void operator=(const TimerWheel&) = delete;
+
+    /* 在 delay 之后执行一次 cb */
+    TimerHandle Schedule(std::chrono::nanoseconds delay, Callback cb);
+
+    /* 每隔 period 执行一次 cb，直到被取消 */
+    TimerHandle Every(std::chrono::nanoseconds period, Callback cb);
+
+    /* 停止时间轮线程，尚未到期的定时器全部丢弃，之后的注册都会被忽略 */
+    void Shutdown();
+
+    /* 当前线程是否是时间轮线程（在其中不能做任何阻塞等待） */
+    static bool InTimerThread();
+
+    /* get 已经执行的回调数量 */
+    uint64_t GetFiredCount() const { return fired_count_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr unsigned   kLevels = 4;
+    static constexpr unsigned   kSlotBits = 8;
+    static constexpr unsigned   kSlots = 1u << kSlotBits;
+    static constexpr std::chrono::milliseconds kTick{1};
+
+    TimerWheel();
+
+    TimerHandle Add_(std::chrono::nanoseconds delay, std::chrono::nanoseconds period, Callback cb);
+
+    /* 把定时器放进与到期时间相对应的层和槽，调用方持有 mutex_ */
+    void Insert_(std::shared_ptr<TimerEntry> entry);
+
+    /* 前进一个 tick，把到期的定时器放进 due，调用方持有 mutex_ */
+    void Tick_(std::vector<std::shared_ptr<TimerEntry>>& due);
+
+    /* 当前时间对应的 tick */
+    uint64_t NowTick_() const;
+
+    void ThreadFunc_();
+
+    std::mutex                  mutex_;
+    std::condition_variable     cond_;
+    std::vector<std::shared_ptr<TimerEntry>>    wheel_[kLevels][kSlots];
+    uint64_t                    current_tick_;  // 已经处理完的 tick
+    size_t                      count_;         // 时间轮中的定时器数量（包括已取消但还没到期的）
+    std::chrono::steady_clock::time_point   start_;     // tick 0 对应的时间
+    bool                        shutdown_;
+    std::atomic<uint64_t>       fired_count_;
+
+    std::thread                 thread_;
+};
+
+#endif //TINYEDGEPLAYER_TIMER_WHEEL_H
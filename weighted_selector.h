@@ -0,0 +1,228 @@
+#ifndef TINYEDGEPLAYER_WEIGHTED_SELECTOR_H
+#define TINYEDGEPLAYER_WEIGHTED_SELECTOR_H
+
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <vector>
+
+/*
+ * 按权重随机选择：Vose 别名表（M. D. Vose, "A linear algorithm for generating random numbers with a given distribution", 1991）
+ * 构建 O(n)，选择 O(1)：先均匀地选一列，再抛一次硬币决定取这一列本身还是它的别名
+ *
+ * 构建后只读，可以被多个线程同时 Pick()；权重变化时整体重建
+ * 权重 <= 0 的项永远不会被选中
+ */
+class AliasTable
+{
+public:
+    AliasTable() = default;
+
+    explicit AliasTable(const std::vector<int>& weights)
+    {
+        double sum = 0;
+        for (int w : weights)
+            sum += w > 0 ? w : 0;
+
+        if (sum <= 0)
+            return;     // 没有可选的项，保持为空
+
+        size_t n = weights.size();
+        prob_.assign(n, 1.0);
+        alias_.resize(n);
+
+        // 把权重缩放到平均值为 1，小于 1 的列需要用别名补满
+        std::vector<double> scaled(n);
+        std::vector<size_t> small, large;
+        for (size_t i = 0; i < n; ++ i)
+        {
+            scaled[i] = (weights[i] > 0 ? weights[i] : 0) * n / sum;
+            alias_[i] = i;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+
+        while (!small.empty() && !large.empty())
+        {
+            size_t l = small.back();
+            small.pop_back();
+            size_t g = large.back();
+            large.pop_back();
+
+            prob_[l] = scaled[l];
+            alias_[l] = g;
+
+            scaled[g] = scaled[g] + scaled[l] - 1.0;
+            (scaled[g] < 1.0 ? small : large).push_back(g);
+        }
+
+        // 剩下的列概率为 1（small 中剩下的只可能是浮点误差造成的）
+        for (size_t i : large)
+            prob_[i] = 1.0;
+        for (size_t i : small)
+            prob_[i] = 1.0;
+    }
+
+    /* 所有权重都 <= 0 时为空，不能调用 Pick() */
+    bool Empty() const { return prob_.empty(); }
+
+    template<typename Engine>
+    size_t Pick(Engine& engine) const
+    {
+        std::uniform_int_distribution<size_t> column(0, prob_.size() - 1);
+        std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+        size_t i = column(engine);
+        return coin(engine) < prob_[i] ? i : alias_[i];
+    }
+
+private:
+    std::vector<double> prob_;      // 取这一列本身的概率
+    std::vector<size_t> alias_;     // 这一列的别名
+};
+
+/*
+ * 平滑加权轮询：按步长调度（stride scheduling）实现，每一项的步长为 1/weight，
+ * 每次选出下一次调度时间（pass）最小的一项，再把它的 pass 加上步长；
+ * 选择顺序与 nginx 的平滑加权轮询一样交错分布，但用二叉堆维护，选择和修改单个权重都是 O(log n)，内存 O(n)，与权重的大小无关
+ *
+ * 非线程安全，由调用方加锁；权重 <= 0 的项永远不会被选中
+ */
+class SmoothWeightedHeap
+{
+public:
+    SmoothWeightedHeap() : vtime_(0), positive_(0) {}
+
+    explicit SmoothWeightedHeap(const std::vector<int>& weights) : SmoothWeightedHeap()
+    {
+        Reset(weights);
+    }
+
+    /* 按新的权重重建，所有项从头开始调度 */
+    void Reset(const std::vector<int>& weights)
+    {
+        size_t n = weights.size();
+
+        vtime_ = 0;
+        positive_ = 0;
+        stride_.assign(n, kNever);
+        pass_.assign(n, kNever);
+        heap_.resize(n);
+        pos_.resize(n);
+
+        for (size_t i = 0; i < n; ++ i)
+        {
+            if (weights[i] > 0)
+            {   // 从半个步长开始，权重相同的项按角标顺序轮流
+                stride_[i] = 1.0 / weights[i];
+                pass_[i] = stride_[i] / 2;
+                ++ positive_;
+            }
+            heap_[i] = i;
+            pos_[i] = i;
+        }
+
+        for (size_t i = n / 2; i-- > 0; )
+            SiftDown_(i);
+    }
+
+    /* 没有权重为正的项时为空，不能调用 Pick() */
+    bool Empty() const { return positive_ == 0; }
+
+    size_t Size() const { return heap_.size(); }
+
+    /* 选出下一项，O(log n) */
+    size_t Pick()
+    {
+        size_t top = heap_[0];
+
+        vtime_ = pass_[top];
+        pass_[top] += stride_[top];
+        SiftDown_(0);
+
+        return top;
+    }
+
+    /*
+     * 修改第 index 项的权重，O(log n)
+     * 距离下一次被调度还剩的时间按新旧步长的比例缩放，其他项的调度顺序不受影响
+     */
+    void Update(size_t index, int weight)
+    {
+        double old_stride = stride_[index];
+        double new_stride = weight > 0 ? 1.0 / weight : kNever;
+
+        if (old_stride == kNever && new_stride != kNever)
+            ++ positive_;
+        else if (old_stride != kNever && new_stride == kNever)
+            -- positive_;
+
+        stride_[index] = new_stride;
+        if (new_stride == kNever)
+            pass_[index] = kNever;
+        else if (old_stride == kNever)
+            pass_[index] = vtime_ + new_stride / 2;
+        else
+            pass_[index] = vtime_ + (pass_[index] > vtime_ ? pass_[index] - vtime_ : 0) * (new_stride / old_stride);
+
+        SiftUp_(pos_[index]);
+        SiftDown_(pos_[index]);
+    }
+
+private:
+    static constexpr double kNever = std::numeric_limits<double>::infinity();
+
+    bool Less_(size_t a, size_t b) const
+    {
+        return pass_[a] != pass_[b] ? pass_[a] < pass_[b] : a < b;
+    }
+
+    void Swap_(size_t i, size_t j)
+    {
+        std::swap(heap_[i], heap_[j]);
+        pos_[heap_[i]] = i;
+        pos_[heap_[j]] = j;
+    }
+
+    void SiftUp_(size_t i)
+    {
+        while (i > 0)
+        {
+            size_t parent = (i - 1) / 2;
+            if (!Less_(heap_[i], heap_[parent]))
+                break;
+            Swap_(i, parent);
+            i = parent;
+        }
+    }
+
+    void SiftDown_(size_t i)
+    {
+        size_t n = heap_.size();
+
+        while (true)
+        {
+            size_t smallest = i;
+            size_t left = 2 * i + 1;
+            size_t right = left + 1;
+
+            if (left < n && Less_(heap_[left], heap_[smallest]))
+                smallest = left;
+            if (right < n && Less_(heap_[right], heap_[smallest]))
+                smallest = right;
+            if (smallest == i)
+                return;
+
+            Swap_(i, smallest);
+            i = smallest;
+        }
+    }
+
+    std::vector<size_t> heap_;      // 按 pass_ 排列的最小堆，存储项的角标
+    std::vector<size_t> pos_;       // 每一项在 heap_ 中的位置
+    std::vector<double> pass_;      // 每一项下一次被调度的虚拟时间
+    std::vector<double> stride_;    // 每一项的步长，权重 <= 0 时为无穷大
+    double              vtime_;     // 最近一次被选出的项的 pass，即当前虚拟时间
+    size_t              positive_;  // 权重为正的项数
+};
+
+#endif //TINYEDGEPLAYER_WEIGHTED_SELECTOR_H
@@ -0,0 +1,150 @@
+#ifndef TINYEDGEPLAYER_WORK_STEALING_DEQUE_H
+#define TINYEDGEPLAYER_WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+/*
+ * Chase-Lev 工作窃取双端队列
+ * 参考 Lê et al., "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP'13
+ *
+ * 只有队列的拥有者（owner）线程可以调用 Push() 和 Pop()，它们操作队列的底部（bottom），无锁且几乎无竞争；
+ * 其它线程调用 Steal() 从队列顶部（top）窃取元素，互相之间只通过一次 CAS 竞争
+ *
+ * T 必须是指针类型，nullptr 表示“没有取到元素”
+ */
+template<typename T>
+class WorkStealingDeque
+{
+    static_assert(std::is_pointer<T>::value, "WorkStealingDeque 只能存放指针");
+
+public:
+    explicit WorkStealingDeque(int64_t capacity = 256)
+        : top_(0), bottom_(0)
+    {
+        auto array = std::make_unique<Array>(capacity);
+        array_.store(array.get(), std::memory_order_relaxed);
+        arrays_.emplace_back(std::move(array));
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    void operator=(const WorkStealingDeque&) = delete;
+
+    /* owner 线程：向底部压入一个元素 */
+    void Push(T item)
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Array* a = array_.load(std::memory_order_relaxed);
+
+        if (b - t > a->capacity - 1)
+        {   // 队列已满，扩容
+            a = Grow_(a, b, t);
+        }
+
+        a->Put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /* owner 线程：从底部弹出一个元素，队列为空时返回 nullptr */
+    T Pop()
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Array* a = array_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        T item = nullptr;
+        if (t <= b)
+        {
+            item = a->Get(b);
+            if (t == b)
+            {   // 只剩最后一个元素，和窃取者竞争
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    item = nullptr;
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+        {   // 队列为空，恢复 bottom
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+
+        return item;
+    }
+
+    /* 任意线程：从顶部窃取一个元素，队列为空或竞争失败时返回 nullptr */
+    T Steal()
+    {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+
+        if (t >= b)
+            return nullptr;
+
+        Array* a = array_.load(std::memory_order_acquire);
+        T item = a->Get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+
+        return item;
+    }
+
+    /* 近似的元素数量，仅用于统计 */
+    int64_t Size() const
+    {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? b - t : 0;
+    }
+
+private:
+    /* 环形数组，容量必须是2的幂 */
+    struct Array
+    {
+        explicit Array(int64_t cap)
+            : capacity(cap), mask(cap - 1), buffer(new std::atomic<T>[cap])
+        {}
+
+        T Get(int64_t i) const
+        {
+            return buffer[i & mask].load(std::memory_order_relaxed);
+        }
+
+        void Put(int64_t i, T item)
+        {
+            buffer[i & mask].store(item, std::memory_order_relaxed);
+        }
+
+        int64_t                         capacity;
+        int64_t                         mask;
+        std::unique_ptr<std::atomic<T>[]> buffer;
+    };
+
+    /* 扩容为原来的两倍；旧数组可能仍在被窃取者读取，因此保留到析构时再释放 */
+    Array* Grow_(Array* old, int64_t b, int64_t t)
+    {
+        auto array = std::make_unique<Array>(old->capacity * 2);
+        for (int64_t i = t; i < b; ++i)
+            array->Put(i, old->Get(i));
+
+        Array* result = array.get();
+        arrays_.emplace_back(std::move(array));
+        array_.store(result, std::memory_order_release);
+        return result;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t>    top_;       // 窃取端
+    alignas(64) std::atomic<int64_t>    bottom_;    // owner 端
+    alignas(64) std::atomic<Array*>     array_;
+    std::vector<std::unique_ptr<Array>> arrays_;    // 所有分配过的数组，只有 owner 线程修改
+};
+
+#endif //TINYEDGEPLAYER_WORK_STEALING_DEQUE_H